@@ -0,0 +1,95 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Translation unit holding nothing but one driver instance, so "make size" reports the footprint of the driver
+// alone. Every setter is left out unless its define is given, e.g.
+//
+//   make size FOOTPRINT="-DFOOTPRINT_OUTPUT_PERIOD=100 -DFOOTPRINT_DISTANCE_UNIT=tfmini::UNIT_MM"
+//
+// Define FOOTPRINT_RUNTIME to use the runtime setters instead of the compile time ones. The object is only
+// compiled, never linked, so the transport is just declared.
+
+#include "../../src/tfmini.h"
+
+#ifdef FOOTPRINT_RUNTIME
+#define FOOTPRINT_SET(setter, value) if((status = driver.setter(value)) != tfmini::Comm::STATUS_SUCCESS) return status
+#else
+#define FOOTPRINT_SET(setter, value) if((status = driver.setter<value>()) != tfmini::Comm::STATUS_SUCCESS) return status
+#endif
+
+namespace footprint
+{
+    void send(tfmini::uint8_t device_id, const tfmini::uint8_t *buffer, tfmini::int16_t len);
+    void receive(tfmini::uint8_t device_id, tfmini::uint8_t *buffer, tfmini::int16_t len);
+
+    class Driver: public tfmini::TFmini
+    {
+        public:
+            Driver():
+                TFmini{0, send, receive}
+            {
+            }
+    };
+
+    Driver driver;
+
+    tfmini::Comm::Status configure()
+    {
+        tfmini::Comm::Status status = tfmini::Comm::STATUS_SUCCESS;
+
+#ifdef FOOTPRINT_OUTPUT_FORMAT
+        FOOTPRINT_SET(setOutputDataFormat, FOOTPRINT_OUTPUT_FORMAT);
+#endif
+#ifdef FOOTPRINT_OUTPUT_PERIOD
+        FOOTPRINT_SET(setOutputPeriod, FOOTPRINT_OUTPUT_PERIOD);
+#endif
+#ifdef FOOTPRINT_DISTANCE_UNIT
+        FOOTPRINT_SET(setDistanceUnit, FOOTPRINT_DISTANCE_UNIT);
+#endif
+#ifdef FOOTPRINT_DETECTION_PATTERN
+        FOOTPRINT_SET(setDetectionPattern, FOOTPRINT_DETECTION_PATTERN);
+#endif
+#ifdef FOOTPRINT_DISTANCE_MODE
+        FOOTPRINT_SET(setDistanceMode, FOOTPRINT_DISTANCE_MODE);
+#endif
+#ifdef FOOTPRINT_RANGE_LIMIT
+        FOOTPRINT_SET(setRangeLimit, FOOTPRINT_RANGE_LIMIT);
+#endif
+#ifdef FOOTPRINT_STRENGTH_LOW
+        FOOTPRINT_SET(setSignalStrengthLow, FOOTPRINT_STRENGTH_LOW);
+#endif
+#ifdef FOOTPRINT_STRENGTH_HI
+        FOOTPRINT_SET(setSignalStrengthHi, FOOTPRINT_STRENGTH_HI);
+#endif
+#ifdef FOOTPRINT_TRIGGER_SOURCE
+        FOOTPRINT_SET(setTriggerSrc, FOOTPRINT_TRIGGER_SOURCE);
+#endif
+#ifdef FOOTPRINT_BAUD_RATE
+        FOOTPRINT_SET(setBaudRate, FOOTPRINT_BAUD_RATE);
+#endif
+
+        return status;
+    }
+
+    bool read(tfmini::Measurement *measure)
+    {
+        return driver.readMeasure(measure);
+    }
+}
@@ -20,6 +20,8 @@
 
 #include <iostream>
 
+#include <QElapsedTimer>
+
 #include "bsp_tfmini.h"
 
 BSP_TFmini tf[2]{{1},{2}};
@@ -44,10 +46,38 @@ namespace tfmini
         do num_read += tf[device_id - 1].m_port.read((char*)(buffer + num_read), len - num_read);
         while(num_read != len && tf[device_id - 1].m_port.waitForReadyRead(100));
     }
+
+    tfmini::int16_t receive_until(tfmini::uint8_t device_id, tfmini::uint8_t *buffer, tfmini::int16_t len, tfmini::uint32_t deadline)
+    {
+        if(!tf[device_id - 1].m_port.isOpen()) return 0;
+
+        tf[device_id - 1].m_port.clearError();
+        int num_read = 0;
+        while(true)
+        {
+            const qint64 count = tf[device_id - 1].m_port.read((char*)(buffer + num_read), len - num_read);
+            if(count > 0) num_read += count;
+            if(num_read == len) break;
+
+            const tfmini::int32_t remaining = tfmini::int32_t(deadline - now());
+            if(remaining <= 0 || !tf[device_id - 1].m_port.waitForReadyRead(remaining)) break;
+        }
+
+        return num_read;
+    }
+
+    tfmini::uint32_t now()
+    {
+        static QElapsedTimer timer;
+        if(!timer.isValid())
+            timer.start();
+
+        return tfmini::uint32_t(timer.elapsed());
+    }
 }
 
 BSP_TFmini::BSP_TFmini(tfmini::uint8_t device_id):
-    tfmini::TFmini(device_id, &tfmini::send, &tfmini::receive)
+    tfmini::TFmini(device_id, &tfmini::send, &tfmini::receive, &tfmini::receive_until)
 {
     m_port.setBaudRate(QSerialPort::Baud115200);
     m_port.setDataBits(QSerialPort::Data8);
@@ -24,11 +24,14 @@
 #include <QSerialPort>
 
 #include "../../src/tfmini.h"
+#include "../../src/tfmini_fusion.h"
 
 namespace tfmini
 {
     void send(uint8_t device_id, const uint8_t *buffer, int16_t len);
     void receive(uint8_t device_id, uint8_t *buffer, int16_t len);
+    int16_t receive_until(uint8_t device_id, uint8_t *buffer, int16_t len, uint32_t deadline);
+    uint32_t now();
 }
 
 class BSP_TFmini: public tfmini::TFmini
@@ -43,6 +46,7 @@ class BSP_TFmini: public tfmini::TFmini
     private:
         friend void tfmini::send(uint8_t device_id, const uint8_t *buffer, int16_t len);
         friend void tfmini::receive(uint8_t device_id, uint8_t *buffer, int16_t len);
+        friend int16_t tfmini::receive_until(uint8_t device_id, uint8_t *buffer, int16_t len, uint32_t deadline);
 };
 
 constexpr int tf_array_size = 2;
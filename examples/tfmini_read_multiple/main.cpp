@@ -45,7 +45,7 @@ int main(int argc, char *argv[])
     csv_stream.setFieldAlignment(QTextStream::AlignLeft);
     csv_stream.setRealNumberNotation(QTextStream::FixedNotation);
     csv_stream.setRealNumberPrecision(2);
-    csv_stream<<"Reading,"<<
+    csv_stream<<"Timestamp,"<<
                 "Measurement1,"<<
                 "Measurement2"<<endl;
 
@@ -56,40 +56,58 @@ int main(int argc, char *argv[])
         tf[i].setDetectionPattern(tfmini::DETECTION_AUTO);
     }
 
-    unsigned int reading = 0;
+    // Align both sensors on a common 20ms timeline. Wait at most 100ms for a sensor and use samples up to 30ms away.
+    tfmini::Fusion<tf_array_size> fusion(20, 100, 30);
+
     while(true)
     {
-        csv_stream << reading << ",";
-        std::cout<<std::fixed << std::setprecision(0)<<"Num:"<<reading;
-        ++reading;
-
-        tfmini::Measurement measure[tf_array_size];
-
         for(int i = 0; i < tf_array_size; ++i)
         {
-            if(tf[i].readMeasure(&measure[i]))
-            {
-                std::cout<<"\tDistance" <<
-                           i <<
-                           ":" <<
-                           float(measure[i].reading);
+            // Every sensor gets its own slice of the 20ms iteration, so a silent sensor can not stall the others
+            const tfmini::uint32_t deadline = tfmini::now() + 20 / tf_array_size;
 
-                csv_stream << float(measure[i].reading);
+            tfmini::TimedMeasurement sample;
+            if(tf[i].readMeasure(&sample.measure, deadline) == tfmini::Comm::STATUS_SUCCESS)
+            {
+                sample.timestamp = tfmini::now();
+                fusion.push(i, sample);
             }
-            else
+        }
+
+        fusion.process(tfmini::now());
+
+        tfmini::AlignedFrame<tf_array_size> frame;
+        while(fusion.pop(&frame))
+        {
+            csv_stream << frame.timestamp << ",";
+            std::cout<<std::fixed << std::setprecision(0)<<"Time:"<<frame.timestamp;
+
+            for(int i = 0; i < tf_array_size; ++i)
             {
-                std::cout<<"\tDistance" <<
-                           i <<
-                           ":NULL";
-                csv_stream << "NULL";
+                if(frame.valid & (1u << i))
+                {
+                    std::cout<<"\tDistance" <<
+                               i <<
+                               ":" <<
+                               float(frame.measure[i].reading);
+
+                    csv_stream << float(frame.measure[i].reading);
+                }
+                else
+                {
+                    std::cout<<"\tDistance" <<
+                               i <<
+                               ":NULL";
+                    csv_stream << "NULL";
+                }
+
+                if(i < tf_array_size - 1)
+                    csv_stream << ",";
             }
 
-            if(i < tf_array_size - 1)
-                csv_stream << ",";
+            std::cout << std::endl;
+            csv_stream << endl;
         }
-
-        std::cout << std::endl;
-        csv_stream << endl;
     }
 
     file.flush();
@@ -35,6 +35,14 @@ CONFIG(debug, debug|release) {
 QMAKE_CXXFLAGS += -std=c++17
 #QMAKE_LFLAGS += -Xlinker -Map=output.map
 
+# RAM/flash footprint of the driver alone, built with the compiler flags of this project: "make size". Select the
+# setters with FOOTPRINT, see ../footprint/tfmini_footprint.cpp. Set SIZE for cross toolchains, e.g. arm-none-eabi-size
+isEmpty(SIZE): SIZE = size
+size.commands = $(CXX) -c $(CXXFLAGS) $(FOOTPRINT) -o tfmini_footprint.o $$PWD/../footprint/tfmini_footprint.cpp && \
+                $$SIZE -B -d tfmini_footprint.o
+QMAKE_EXTRA_TARGETS += size
+QMAKE_CLEAN += tfmini_footprint.o
+
 SOURCES += \
         main.cpp \
     bsp_tfmini.cpp
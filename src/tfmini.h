@@ -22,6 +22,7 @@
 #define TFMINI_H
 
 #include "tfmini_comm.h"
+#include "tfmini_profile.h"
 
 namespace tfmini
 {
@@ -36,129 +37,269 @@ namespace tfmini
             {
             }
 
+            TFmini(uint8_t device_id, send_t send, receive_t receive, receive_until_t receive_until):
+                Comm{device_id, send, receive, receive_until}
+            {
+            }
+
         public:
+            // Parameter validation and frame construction. Usable at compile time.
+            static constexpr bool isValidOutputPeriod(const uint16_t period_ms)
+            {
+                return (period_ms % 10) == 0;
+            }
+
+            static constexpr bool isValidRangeLimit(const uint16_t range_mm)
+            {
+                return (range_mm >= 300 && range_mm <= 12000) || range_mm == 0;
+            }
+
+            static constexpr bool isValidSignalStrengthLow(const uint8_t low_threshold)
+            {
+                return low_threshold <= 80;
+            }
+
+            static constexpr bool isValidSignalStrengthHi(const uint16_t hi_threshold)
+            {
+                return hi_threshold <= 3000;
+            }
+
+            static constexpr Frame outputPeriodFrame(const uint16_t period_ms)
+            {
+                return makeFrame(CMD_OUTPUT_DATA_PERIOD, period_ms & 0x00FF, (period_ms & 0xFF00)>>8);
+            }
+
+            static constexpr Frame rangeLimitFrame(const uint16_t range_mm)
+            {
+                return makeFrame(CMD_RANGE_LIMIT, range_mm & 0x00FF, (range_mm & 0xFF00)>>8, range_mm == 0 ? 0x00 : 0x01);
+            }
+
+            static constexpr Frame signalStrengthLowFrame(const uint8_t low_threshold)
+            {
+                return makeFrame(CMD_SIGNAL_STRENGTH_LOW, low_threshold);
+            }
+
+            static constexpr Frame signalStrengthHiFrame(const uint16_t hi_threshold)
+            {
+                return makeFrame(CMD_SIGNAL_STRENGTH_HI, hi_threshold & 0x00FF, (hi_threshold & 0xFF00)>>8);
+            }
 
             Comm::Status setOutputDataFormat(const OutputDataFormat format)
             {
-                m_command_list[CMD_OUTPUT_DATA_FORMAT][6] = format;
-                return execCmd(m_command_list[CMD_OUTPUT_DATA_FORMAT]);
+                return remember(execCmd(CMD_OUTPUT_DATA_FORMAT, makeFrame(CMD_OUTPUT_DATA_FORMAT, 0x00, 0x00, format)), &Profile::setOutputDataFormat, format);
             }
 
             Comm::Status setOutputPeriod(const uint16_t period_ms)
             {
-                if( (period_ms % 10) == 0)
-                {
-                    m_command_list[CMD_OUTPUT_DATA_PERIOD][4] = period_ms & 0x00FF;
-                    m_command_list[CMD_OUTPUT_DATA_PERIOD][5] = (period_ms & 0xFF00)>>8;
-                    return execCmd(m_command_list[CMD_OUTPUT_DATA_PERIOD]);
-                }
+                if(isValidOutputPeriod(period_ms))
+                    return remember(execCmd(CMD_OUTPUT_DATA_PERIOD, outputPeriodFrame(period_ms)), &Profile::setOutputPeriod, period_ms);
 
                 return STATUS_ERROR_PARAMETER;
             }
 
             Comm::Status setDistanceUnit(const DistanceUnit unit)
             {
-                m_command_list[CMD_UNIT_OF_DISTANCE][6] = unit;
-                return execCmd(m_command_list[CMD_UNIT_OF_DISTANCE]);
+                return remember(execCmd(CMD_UNIT_OF_DISTANCE, makeFrame(CMD_UNIT_OF_DISTANCE, 0x00, 0x00, unit)), &Profile::setDistanceUnit, unit);
             }
 
             Comm::Status setDetectionPattern(const DetectionPattern pattern)
             {
-                m_command_list[CMD_DETECTION_PATTERN][6] = pattern;
-                return execCmd(m_command_list[CMD_DETECTION_PATTERN]);
+                return remember(execCmd(CMD_DETECTION_PATTERN, makeFrame(CMD_DETECTION_PATTERN, 0x00, 0x00, pattern)), &Profile::setDetectionPattern, pattern);
             }
 
             Comm::Status setDistanceMode(const DistanceMode mode)
             {
-                if(setDetectionPattern(DETECTION_FIX) != STATUS_SUCCESS)
+                if(!isPatternFixed() && setDetectionPattern(DETECTION_FIX) != STATUS_SUCCESS)
                     return STATUS_ERROR_TRANSMISSION;
 
-                m_command_list[CMD_DISTANCE_MODE][6] = mode;
-                return execCmd(m_command_list[CMD_DISTANCE_MODE]);
+                return remember(execCmd(CMD_DISTANCE_MODE, makeFrame(CMD_DISTANCE_MODE, 0x00, 0x00, mode)), &Profile::setDistanceMode, mode);
             }
 
             Comm::Status setRangeLimit(const uint16_t range_mm)
             {
-                if(range_mm >= 300 && range_mm <= 12000)
-                {
-                    m_command_list[CMD_RANGE_LIMIT][4] = range_mm & 0x00FF;
-                    m_command_list[CMD_RANGE_LIMIT][5] = (range_mm & 0xFF00)>>8;
-                    m_command_list[CMD_RANGE_LIMIT][6] = 0x01;
-                    return execCmd(m_command_list[CMD_RANGE_LIMIT]);
-                }
-                else if(range_mm == 0)
-                {
-                    m_command_list[CMD_RANGE_LIMIT][4] = 0x00;
-                    m_command_list[CMD_RANGE_LIMIT][5] = 0x00;
-                    m_command_list[CMD_RANGE_LIMIT][6] = 0x00;
-                    return execCmd(m_command_list[CMD_RANGE_LIMIT]);
-                }
+                if(isValidRangeLimit(range_mm))
+                    return remember(execCmd(CMD_RANGE_LIMIT, rangeLimitFrame(range_mm)), &Profile::setRangeLimit, range_mm);
 
                 return STATUS_ERROR_PARAMETER;
             }
 
             Comm::Status setSignalStrengthLow(const uint8_t low_threshold)
             {
-                if(low_threshold <= 80)
-                {
-                    m_command_list[CMD_SIGNAL_STRENGTH_LOW][4] = low_threshold;
-                    return execCmd(m_command_list[CMD_SIGNAL_STRENGTH_LOW]);
-                }
+                if(isValidSignalStrengthLow(low_threshold))
+                    return remember(execCmd(CMD_SIGNAL_STRENGTH_LOW, signalStrengthLowFrame(low_threshold)), &Profile::setSignalStrengthLow, low_threshold);
 
                 return STATUS_ERROR_PARAMETER;
             }
 
             Comm::Status setSignalStrengthHi(const uint16_t hi_threshold)
             {
-                if(hi_threshold <= 3000)
-                {
-                    m_command_list[CMD_SIGNAL_STRENGTH_HI][4] = hi_threshold & 0x00FF;
-                    m_command_list[CMD_SIGNAL_STRENGTH_HI][5] = (hi_threshold & 0xFF00)>>8;
-                    return execCmd(m_command_list[CMD_SIGNAL_STRENGTH_HI]);
-                }
+                if(isValidSignalStrengthHi(hi_threshold))
+                    return remember(execCmd(CMD_SIGNAL_STRENGTH_HI, signalStrengthHiFrame(hi_threshold)), &Profile::setSignalStrengthHi, hi_threshold);
 
                 return STATUS_ERROR_PARAMETER;
             }
 
             Comm::Status setBaudRate(const BaudRate br)
             {
-                m_command_list[ADV_BAUD_RATE][6] = br;
-                return execCmd(m_command_list[ADV_BAUD_RATE]);
+                return remember(execCmd(ADV_BAUD_RATE, makeFrame(ADV_BAUD_RATE, 0x00, 0x00, br)), &Profile::setBaudRate, br);
             }
 
             Comm::Status setTriggerSrc(const TriggerSrc trigger)
             {
-                m_command_list[ADV_TRIGGER_SOURCE][6] = trigger;
-                return execCmd(m_command_list[ADV_TRIGGER_SOURCE]);
+                return remember(execCmd(ADV_TRIGGER_SOURCE, makeFrame(ADV_TRIGGER_SOURCE, 0x00, 0x00, trigger)), &Profile::setTriggerSrc, trigger);
             }
 
             Comm::Status triggerMeasurement()
             {
-                return execCmd(m_command_list[ADV_TRIGGER_EXTERNAL]);
+                return execCmd(ADV_TRIGGER_EXTERNAL, m_trigger_frame);
             }
 
+            // Restores the factory settings, so nothing is known about the applied configuration afterwards
             Comm::Status reset()
             {
-                return execCmd(m_command_list[ADV_RESET]);
+                m_applied = Profile{};
+                return execCmd(ADV_RESET, m_reset_frame);
             }
 
-        protected:
-            Comm::Status execCmd(uint8_t *cmd)
+            // Send only the settings of the profile that differ from the configuration applied so far. The baud
+            // rate is changed last, because the transport has to follow it.
+            Comm::Status apply(const Profile &profile)
             {
-                if(cmd == nullptr)
-                    return Comm::STATUS_ERROR_TRANSMISSION;
+                Comm::Status status = STATUS_SUCCESS;
+
+                if((profile.diff(m_applied) & Profile::FIELD_FORMAT) && (status = setOutputDataFormat(profile.format)) != STATUS_SUCCESS)
+                    return status;
+                if((profile.diff(m_applied) & Profile::FIELD_PERIOD) && (status = setOutputPeriod(profile.period_ms)) != STATUS_SUCCESS)
+                    return status;
+                if((profile.diff(m_applied) & Profile::FIELD_UNIT) && (status = setDistanceUnit(profile.unit)) != STATUS_SUCCESS)
+                    return status;
+                if((profile.diff(m_applied) & Profile::FIELD_RANGE_LIMIT) && (status = setRangeLimit(profile.range_mm)) != STATUS_SUCCESS)
+                    return status;
+                if((profile.diff(m_applied) & Profile::FIELD_STRENGTH_LOW) && (status = setSignalStrengthLow(profile.strength_low)) != STATUS_SUCCESS)
+                    return status;
+                if((profile.diff(m_applied) & Profile::FIELD_STRENGTH_HI) && (status = setSignalStrengthHi(profile.strength_hi)) != STATUS_SUCCESS)
+                    return status;
+                // Setting the distance mode switches to a fixed detection pattern, so the pattern comes after it
+                if((profile.diff(m_applied) & Profile::FIELD_MODE) && (status = setDistanceMode(profile.mode)) != STATUS_SUCCESS)
+                    return status;
+                if((profile.diff(m_applied) & Profile::FIELD_PATTERN) && (status = setDetectionPattern(profile.pattern)) != STATUS_SUCCESS)
+                    return status;
+                if((profile.diff(m_applied) & Profile::FIELD_TRIGGER) && (status = setTriggerSrc(profile.trigger)) != STATUS_SUCCESS)
+                    return status;
+                if((profile.diff(m_applied) & Profile::FIELD_BAUD_RATE) && (status = setBaudRate(profile.baud_rate)) != STATUS_SUCCESS)
+                    return status;
+
+                return status;
+            }
+
+            // Configuration applied through this object since it was created or last reset
+            const Profile &getAppliedProfile() const
+            {
+                return m_applied;
+            }
+
+            // Seed the cache, e.g. with a profile stored before a restart, when the sensor is known to still hold it
+            void setAppliedProfile(const Profile &profile)
+            {
+                m_applied = profile;
+            }
 
+            // Compile time variants of the setters. Invalid parameters are rejected by the compiler and the frame
+            // is a constant in read only memory.
+            template<OutputDataFormat format>
+            Comm::Status setOutputDataFormat()
+            {
+                static constexpr Frame frame = makeFrame(CMD_OUTPUT_DATA_FORMAT, 0x00, 0x00, format);
+                return remember(execCmd(CMD_OUTPUT_DATA_FORMAT, frame), &Profile::setOutputDataFormat, format);
+            }
+
+            template<uint16_t period_ms>
+            Comm::Status setOutputPeriod()
+            {
+                static_assert(isValidOutputPeriod(period_ms), "Output period must be a multiple of 10ms");
+                static constexpr Frame frame = outputPeriodFrame(period_ms);
+                return remember(execCmd(CMD_OUTPUT_DATA_PERIOD, frame), &Profile::setOutputPeriod, period_ms);
+            }
+
+            template<DistanceUnit unit>
+            Comm::Status setDistanceUnit()
+            {
+                static constexpr Frame frame = makeFrame(CMD_UNIT_OF_DISTANCE, 0x00, 0x00, unit);
+                return remember(execCmd(CMD_UNIT_OF_DISTANCE, frame), &Profile::setDistanceUnit, unit);
+            }
+
+            template<DetectionPattern pattern>
+            Comm::Status setDetectionPattern()
+            {
+                static constexpr Frame frame = makeFrame(CMD_DETECTION_PATTERN, 0x00, 0x00, pattern);
+                return remember(execCmd(CMD_DETECTION_PATTERN, frame), &Profile::setDetectionPattern, pattern);
+            }
+
+            template<DistanceMode mode>
+            Comm::Status setDistanceMode()
+            {
+                if(!isPatternFixed() && setDetectionPattern<DETECTION_FIX>() != STATUS_SUCCESS)
+                    return STATUS_ERROR_TRANSMISSION;
+
+                static constexpr Frame frame = makeFrame(CMD_DISTANCE_MODE, 0x00, 0x00, mode);
+                return remember(execCmd(CMD_DISTANCE_MODE, frame), &Profile::setDistanceMode, mode);
+            }
+
+            template<uint16_t range_mm>
+            Comm::Status setRangeLimit()
+            {
+                static_assert(isValidRangeLimit(range_mm), "Range limit must be 0 or between 300mm and 12000mm");
+                static constexpr Frame frame = rangeLimitFrame(range_mm);
+                return remember(execCmd(CMD_RANGE_LIMIT, frame), &Profile::setRangeLimit, range_mm);
+            }
+
+            template<uint8_t low_threshold>
+            Comm::Status setSignalStrengthLow()
+            {
+                static_assert(isValidSignalStrengthLow(low_threshold), "Low signal strength threshold must not exceed 80");
+                static constexpr Frame frame = signalStrengthLowFrame(low_threshold);
+                return remember(execCmd(CMD_SIGNAL_STRENGTH_LOW, frame), &Profile::setSignalStrengthLow, low_threshold);
+            }
+
+            template<uint16_t hi_threshold>
+            Comm::Status setSignalStrengthHi()
+            {
+                static_assert(isValidSignalStrengthHi(hi_threshold), "High signal strength threshold must not exceed 3000");
+                static constexpr Frame frame = signalStrengthHiFrame(hi_threshold);
+                return remember(execCmd(CMD_SIGNAL_STRENGTH_HI, frame), &Profile::setSignalStrengthHi, hi_threshold);
+            }
+
+            template<BaudRate br>
+            Comm::Status setBaudRate()
+            {
+                static constexpr Frame frame = makeFrame(ADV_BAUD_RATE, 0x00, 0x00, br);
+                return remember(execCmd(ADV_BAUD_RATE, frame), &Profile::setBaudRate, br);
+            }
+
+            template<TriggerSrc trigger>
+            Comm::Status setTriggerSrc()
+            {
+                static constexpr Frame frame = makeFrame(ADV_TRIGGER_SOURCE, 0x00, 0x00, trigger);
+                return remember(execCmd(ADV_TRIGGER_SOURCE, frame), &Profile::setTriggerSrc, trigger);
+            }
+
+        protected:
+            Comm::Status execCmd(const Command cmd, const Frame &frame)
+            {
                 for(int i = 0; i < 3; ++i)
                 {
-                    if(sendCommand(m_command_list[ENTER_COMMAND_MODE]) == STATUS_SUCCESS)
+                    TFMINI_TRACE_SCOPE(trace, EVENT_EXEC_RETRY, m_device_id, i);
+
+                    if(sendCommand(m_enter_frame.bytes) == STATUS_SUCCESS)
                     {
-                        Comm::Status status = sendCommand(cmd);
+                        Comm::Status status = sendCommand(frame.bytes);
 
-                        if(  cmd == m_command_list[ADV_BAUD_RATE] || cmd == m_command_list[ADV_TRIGGER_EXTERNAL] ||
-                             cmd == m_command_list[ADV_RESET]     || cmd == m_command_list[ADV_TRIGGER_SOURCE])
+                        // The advanced commands do not need to exit the configuration mode
+                        if(  cmd == ADV_BAUD_RATE || cmd == ADV_TRIGGER_EXTERNAL ||
+                             cmd == ADV_RESET     || cmd == ADV_TRIGGER_SOURCE)
                             return Comm::STATUS_SUCCESS;
 
-                        sendCommand(m_command_list[EXIT_COMMAND_MODE]);
+                        sendCommand(m_exit_frame.bytes);
                         return status;
                     }
                 }
@@ -167,25 +308,27 @@ namespace tfmini
             }
 
         private:
-            static inline uint8_t m_command_list[][8]
-            {
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x01, 0x06},
-                {0x42, 0x57, 0x02, 0x00, 0x0A, 0x00, 0x00, 0x07},
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x01, 0x1A},
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x00, 0x14},
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x00, 0x11},
-                {0x42, 0x57, 0x02, 0x00, 0xE0, 0x2E, 0x01, 0x19},
-                {0x42, 0x57, 0x02, 0x00, 0x14, 0x00, 0x00, 0x20},
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x00, 0x21},
-
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x00, 0x08},
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x00, 0x40},
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x00, 0x41},
-                {0x42, 0x57, 0x02, 0x00, 0xFF, 0xFF, 0xFF, 0xFF},
-
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x01, 0x02},
-                {0x42, 0x57, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02}
-            };
+            // Record a successfully applied setting in the cached profile
+            template<typename T>
+            Comm::Status remember(const Comm::Status status, Profile &(Profile::*setter)(T), const T value)
+            {
+                if(status == STATUS_SUCCESS)
+                    (m_applied.*setter)(value);
+
+                return status;
+            }
+
+            bool isPatternFixed() const
+            {
+                return m_applied.has(Profile::FIELD_PATTERN) && m_applied.pattern == DETECTION_FIX;
+            }
+
+            Profile m_applied;
+
+            static constexpr Frame m_enter_frame   = makeFrame(ENTER_COMMAND_MODE, 0x00, 0x00, 0x01);
+            static constexpr Frame m_exit_frame    = makeFrame(EXIT_COMMAND_MODE);
+            static constexpr Frame m_trigger_frame = makeFrame(ADV_TRIGGER_EXTERNAL);
+            static constexpr Frame m_reset_frame   = makeFrame(ADV_RESET, 0xFF, 0xFF, 0xFF);
     };
 
 }
@@ -0,0 +1,405 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_ARCHIVE_H
+#define TFMINI_ARCHIVE_H
+
+#include "tfmini_defs.h"
+
+// Compressed columnar archive of measurement streams.
+//
+// An archive is a sequence of self contained blocks of up to BlockSize samples. All values are little endian.
+//
+//   offset  size  field
+//        0     4  magic "TFA1"
+//        4     4  block size in bytes, header included
+//        8     2  number of samples
+//       10     4  first timestamp
+//       14     4  last timestamp
+//       18     2  timestamp column size in bytes
+//       20     2  reading column size in bytes
+//       22     2  strength column size in bytes
+//       24        timestamp column: zigzag varint of the delta of the timestamp deltas
+//                 reading column:   zigzag varint of the reading deltas
+//                 strength column:  zigzag varint of the strength deltas
+//                 flags column:     2 bits per sample, bit 0 short_distance, bit 1 checksum
+//
+// The header alone is enough to skip a block or to build an index for seeking by timestamp. Timestamps are
+// expected to be monotonic within an archive.
+
+namespace tfmini
+{
+    // Receives the encoded bytes
+    using archive_writer_t = void (*)(const uint8_t *data, uint32_t len, void *context);
+
+    struct ArchiveBlock
+    {
+            uint32_t size            {0};
+            uint16_t count           {0};
+            uint32_t first_timestamp {0};
+            uint32_t last_timestamp  {0};
+            uint16_t timestamp_bytes {0};
+            uint16_t reading_bytes   {0};
+            uint16_t strength_bytes  {0};
+    };
+
+    struct ArchiveIndexEntry
+    {
+            uint64_t offset          {0};   // Offset of the block from the start of the archive
+            uint32_t first_timestamp {0};
+            uint32_t last_timestamp  {0};
+    };
+
+    // Called for every written block, e.g. to store a side index
+    using archive_index_t = void (*)(const ArchiveIndexEntry &entry, void *context);
+
+    class ArchiveReader
+    {
+        public:
+            static constexpr uint32_t HEADER_SIZE = 24;
+
+            // Parse and check the header of the block at `data`. Returns false if it is not a complete block.
+            static bool readHeader(const uint8_t *data, const uint32_t size, ArchiveBlock *block)
+            {
+                if(data == nullptr || block == nullptr || size < HEADER_SIZE)
+                    return false;
+
+                if(data[0] != 'T' || data[1] != 'F' || data[2] != 'A' || data[3] != '1')
+                    return false;
+
+                block->size            = readU32(data + 4);
+                block->count           = readU16(data + 8);
+                block->first_timestamp = readU32(data + 10);
+                block->last_timestamp  = readU32(data + 14);
+                block->timestamp_bytes = readU16(data + 18);
+                block->reading_bytes   = readU16(data + 20);
+                block->strength_bytes  = readU16(data + 22);
+
+                const uint32_t expected = HEADER_SIZE + block->timestamp_bytes + block->reading_bytes +
+                                          block->strength_bytes + flagBytes(block->count);
+
+                return block->size == expected && block->size <= size;
+            }
+
+            // Decode the block at `data` into `out`. Returns the number of samples or 0 if the block is malformed or
+            // does not fit into `capacity`.
+            static uint16_t decode(const uint8_t *data, const uint32_t size, TimedMeasurement *out, const uint16_t capacity)
+            {
+                ArchiveBlock block;
+                if(out == nullptr || !readHeader(data, size, &block) || block.count > capacity)
+                    return 0;
+
+                const uint8_t *column = data + HEADER_SIZE;
+                uint32_t values[64];
+
+                // Timestamps: two prefix sums over the delta of deltas
+                uint32_t timestamp = block.first_timestamp;
+                uint32_t delta = 0;
+                if(!decodeColumn(column, block.timestamp_bytes, block.count, values, [&](const uint16_t index, const uint32_t value){
+                    delta += uint32_t(unzigzag(value));
+                    timestamp += delta;
+                    out[index].timestamp = timestamp;
+                }))
+                    return 0;
+                column += block.timestamp_bytes;
+
+                uint32_t reading = 0;
+                if(!decodeColumn(column, block.reading_bytes, block.count, values, [&](const uint16_t index, const uint32_t value){
+                    reading += uint32_t(unzigzag(value));
+                    out[index].measure.reading = uint16_t(reading);
+                }))
+                    return 0;
+                column += block.reading_bytes;
+
+                uint32_t strength = 0;
+                if(!decodeColumn(column, block.strength_bytes, block.count, values, [&](const uint16_t index, const uint32_t value){
+                    strength += uint32_t(unzigzag(value));
+                    out[index].measure.strength = uint16_t(strength);
+                }))
+                    return 0;
+                column += block.strength_bytes;
+
+                for(uint16_t i = 0; i < block.count; ++i)
+                {
+                    const uint8_t flags = column[i >> 2] >> ((i & 0x03) * 2);
+                    out[i].measure.short_distance = (flags & 0x01) != 0;
+                    out[i].measure.checksum       = (flags & 0x02) != 0;
+                }
+
+                return block.count;
+            }
+
+            // Index of the first block whose last timestamp is not before `timestamp`, or `entries` if there is none
+            static uint32_t find(const ArchiveIndexEntry *index, const uint32_t entries, const uint32_t timestamp)
+            {
+                uint32_t first = 0;
+                uint32_t last = entries;
+
+                while(index != nullptr && first < last)
+                {
+                    const uint32_t middle = first + (last - first) / 2;
+                    if(index[middle].last_timestamp < timestamp)
+                        first = middle + 1;
+                    else
+                        last = middle;
+                }
+
+                return first;
+            }
+
+            static constexpr uint32_t flagBytes(const uint16_t count)
+            {
+                return (uint32_t(count) * 2 + 7) / 8;
+            }
+
+            static constexpr int32_t unzigzag(const uint32_t value)
+            {
+                return int32_t(value >> 1) ^ -int32_t(value & 0x01);
+            }
+
+        private:
+            // Decode `count` varints and pass them in order to `emit`. Runs of eight single byte varints, the
+            // common case for slowly changing values, are detected with one 64-bit test and unpacked without a
+            // branch per byte.
+            template<typename Emit>
+            static bool decodeColumn(const uint8_t *data, const uint16_t bytes, const uint16_t count, uint32_t (&values)[64], Emit emit)
+            {
+                uint32_t pos = 0;
+                uint16_t index = 0;
+
+                while(index < count)
+                {
+                    uint16_t batch = 0;
+
+                    while(batch < 64 && index + batch < count)
+                    {
+                        if(batch + 8 <= 64 && index + batch + 8 <= count && pos + 8 <= bytes)
+                        {
+                            uint64_t word = 0;
+                            for(uint8_t i = 0; i < 8; ++i)
+                                word |= uint64_t(data[pos + i]) << (i * 8);
+
+                            if((word & 0x8080808080808080ull) == 0)
+                            {
+                                for(uint8_t i = 0; i < 8; ++i)
+                                    values[batch + i] = uint32_t(word >> (i * 8)) & 0xFF;
+
+                                batch += 8;
+                                pos += 8;
+                                continue;
+                            }
+                        }
+
+                        uint32_t value = 0;
+                        uint8_t  shift = 0;
+                        while(true)
+                        {
+                            if(pos >= bytes || shift > 28)
+                                return false;
+
+                            const uint8_t byte = data[pos++];
+                            value |= uint32_t(byte & 0x7F) << shift;
+                            shift += 7;
+
+                            if((byte & 0x80) == 0)
+                                break;
+                        }
+
+                        values[batch++] = value;
+                    }
+
+                    for(uint16_t i = 0; i < batch; ++i)
+                        emit(uint16_t(index + i), values[i]);
+
+                    index += batch;
+                }
+
+                return pos == bytes;
+            }
+
+            static uint16_t readU16(const uint8_t *data)
+            {
+                return uint16_t(data[0] | (data[1] << 8));
+            }
+
+            static uint32_t readU32(const uint8_t *data)
+            {
+                return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+            }
+    };
+
+    // Buffers measurements and writes them as compressed blocks of BlockSize samples through the writer
+    template<uint16_t BlockSize = 1024>
+    class ArchiveWriter
+    {
+            static_assert(BlockSize > 0 && BlockSize <= 4096, "Block size must be between 1 and 4096 samples");
+
+        public:
+            // Worst case: 5 byte timestamp and 3 byte reading and strength varints per sample
+            static constexpr uint32_t MAX_BLOCK_SIZE = ArchiveReader::HEADER_SIZE + uint32_t(BlockSize) * 11 + ArchiveReader::flagBytes(BlockSize);
+
+            ArchiveWriter(archive_writer_t writer, void *context = nullptr):
+                m_writer{writer},
+                m_context{context}
+            {
+            }
+
+            ArchiveWriter(const ArchiveWriter &) = delete;
+            ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+            void setIndexCallback(archive_index_t index, void *context = nullptr)
+            {
+                m_index = index;
+                m_index_context = context;
+            }
+
+            void push(const TimedMeasurement &measure)
+            {
+                m_samples[m_count++] = measure;
+
+                if(m_count == BlockSize)
+                    flush();
+            }
+
+            // Write the buffered samples as a, possibly short, block. Without a writer they are dropped.
+            void flush()
+            {
+                if(m_writer == nullptr)
+                    m_count = 0;
+
+                if(m_count == 0)
+                    return;
+
+                uint8_t *column = m_block + ArchiveReader::HEADER_SIZE;
+
+                uint32_t previous_timestamp = m_samples[0].timestamp;
+                uint32_t previous_delta = 0;
+                const uint8_t *start = column;
+                for(uint16_t i = 0; i < m_count; ++i)
+                {
+                    const uint32_t delta = m_samples[i].timestamp - previous_timestamp;
+                    column = writeVarint(column, zigzag(int32_t(delta - previous_delta)));
+                    previous_timestamp = m_samples[i].timestamp;
+                    previous_delta = delta;
+                }
+                const uint16_t timestamp_bytes = uint16_t(column - start);
+
+                int32_t previous = 0;
+                start = column;
+                for(uint16_t i = 0; i < m_count; ++i)
+                {
+                    column = writeVarint(column, zigzag(int32_t(m_samples[i].measure.reading) - previous));
+                    previous = m_samples[i].measure.reading;
+                }
+                const uint16_t reading_bytes = uint16_t(column - start);
+
+                previous = 0;
+                start = column;
+                for(uint16_t i = 0; i < m_count; ++i)
+                {
+                    column = writeVarint(column, zigzag(int32_t(m_samples[i].measure.strength) - previous));
+                    previous = m_samples[i].measure.strength;
+                }
+                const uint16_t strength_bytes = uint16_t(column - start);
+
+                const uint32_t flag_bytes = ArchiveReader::flagBytes(m_count);
+                for(uint32_t i = 0; i < flag_bytes; ++i)
+                    column[i] = 0;
+                for(uint16_t i = 0; i < m_count; ++i)
+                {
+                    const uint8_t flags = (m_samples[i].measure.short_distance ? 0x01 : 0x00) |
+                                          (m_samples[i].measure.checksum ? 0x02 : 0x00);
+                    column[i >> 2] |= flags << ((i & 0x03) * 2);
+                }
+                column += flag_bytes;
+
+                const uint32_t size = uint32_t(column - m_block);
+                m_block[0] = 'T';
+                m_block[1] = 'F';
+                m_block[2] = 'A';
+                m_block[3] = '1';
+                writeU32(m_block + 4, size);
+                writeU16(m_block + 8, m_count);
+                writeU32(m_block + 10, m_samples[0].timestamp);
+                writeU32(m_block + 14, m_samples[m_count - 1].timestamp);
+                writeU16(m_block + 18, timestamp_bytes);
+                writeU16(m_block + 20, reading_bytes);
+                writeU16(m_block + 22, strength_bytes);
+
+                m_writer(m_block, size, m_context);
+
+                if(m_index != nullptr)
+                    m_index(ArchiveIndexEntry{m_offset, m_samples[0].timestamp, m_samples[m_count - 1].timestamp}, m_index_context);
+
+                m_offset += size;
+                m_count = 0;
+            }
+
+            // Bytes written so far
+            uint64_t getOffset() const
+            {
+                return m_offset;
+            }
+
+        private:
+            static uint32_t zigzag(const int32_t value)
+            {
+                return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+            }
+
+            static uint8_t *writeVarint(uint8_t *data, uint32_t value)
+            {
+                while(value >= 0x80)
+                {
+                    *data++ = uint8_t(value | 0x80);
+                    value >>= 7;
+                }
+
+                *data++ = uint8_t(value);
+                return data;
+            }
+
+            static void writeU16(uint8_t *data, const uint16_t value)
+            {
+                data[0] = value & 0x00FF;
+                data[1] = (value & 0xFF00) >> 8;
+            }
+
+            static void writeU32(uint8_t *data, const uint32_t value)
+            {
+                data[0] = value & 0xFF;
+                data[1] = (value >> 8) & 0xFF;
+                data[2] = (value >> 16) & 0xFF;
+                data[3] = (value >> 24) & 0xFF;
+            }
+
+            archive_writer_t m_writer;
+            void            *m_context;
+            archive_index_t  m_index{nullptr};
+            void            *m_index_context{nullptr};
+
+            TimedMeasurement m_samples[BlockSize];
+            uint16_t         m_count{0};
+            uint8_t          m_block[MAX_BLOCK_SIZE];
+            uint64_t         m_offset{0};
+    };
+}
+
+#endif // TFMINI_ARCHIVE_H
@@ -0,0 +1,201 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_CALIB_H
+#define TFMINI_CALIB_H
+
+#include "tfmini_defs.h"
+
+namespace tfmini
+{
+    // Correction, in reading units, that has to be added to a raw reading with the given strength and mode
+    using correction_t = float (*)(uint16_t reading, uint16_t strength, bool short_distance);
+
+    // Per sensor calibration, stored as one lookup table per distance mode, indexed by reading and strength bins.
+    //
+    // A bin covers (1 << shift) units. Values past the last bin use the last bin. The tables are either computed
+    // from a correction function with build() or loaded from a compact binary image with load(), so applying the
+    // calibration costs one table lookup per measurement.
+    //
+    // Binary image layout, all values little endian:
+    //   "TFCL", version (1 byte), reading shift (1 byte), strength shift (1 byte), reserved (1 byte),
+    //   reading bins (2 bytes), strength bins (2 bytes),
+    //   long distance table followed by the short distance table, each ReadingBins x StrengthBins int16 values
+    template<uint16_t ReadingBins = 64, uint16_t StrengthBins = 16>
+    class Calibration
+    {
+            static_assert(ReadingBins > 0 && StrengthBins > 0, "Calibration table must not be empty");
+
+        public:
+            static constexpr uint8_t  VERSION = 1;
+            static constexpr uint32_t HEADER_SIZE = 12;
+            static constexpr uint32_t IMAGE_SIZE = HEADER_SIZE + 2u * 2u * ReadingBins * StrengthBins;
+
+            explicit Calibration(const uint8_t reading_shift = 5, const uint8_t strength_shift = 8):
+                m_reading_shift{reading_shift > 15 ? uint8_t(15) : reading_shift},
+                m_strength_shift{strength_shift > 15 ? uint8_t(15) : strength_shift}
+            {
+            }
+
+            // Evaluate the correction function at the center of every bin
+            void build(correction_t function)
+            {
+                if(function == nullptr)
+                    return;
+
+                for(uint8_t mode = 0; mode < 2; ++mode)
+                    for(uint16_t r = 0; r < ReadingBins; ++r)
+                        for(uint16_t s = 0; s < StrengthBins; ++s)
+                        {
+                            const uint16_t reading  = binCenter(r, m_reading_shift);
+                            const uint16_t strength = binCenter(s, m_strength_shift);
+                            const float value = function(reading, strength, mode != 0);
+
+                            m_table[mode][r][s] = saturate(value < 0 ? value - 0.5f : value + 0.5f);
+                        }
+            }
+
+            // Load a binary image. Returns false if it is malformed or its dimensions do not match this table.
+            bool load(const uint8_t *data, const uint32_t size)
+            {
+                if(data == nullptr || size < IMAGE_SIZE)
+                    return false;
+
+                if(data[0] != 'T' || data[1] != 'F' || data[2] != 'C' || data[3] != 'L' || data[4] != VERSION)
+                    return false;
+
+                if(readU16(data + 8) != ReadingBins || readU16(data + 10) != StrengthBins || data[5] > 15 || data[6] > 15)
+                    return false;
+
+                m_reading_shift  = data[5];
+                m_strength_shift = data[6];
+
+                const uint8_t *entry = data + HEADER_SIZE;
+                for(uint8_t mode = 0; mode < 2; ++mode)
+                    for(uint16_t r = 0; r < ReadingBins; ++r)
+                        for(uint16_t s = 0; s < StrengthBins; ++s, entry += 2)
+                            m_table[mode][r][s] = int16_t(readU16(entry));
+
+                return true;
+            }
+
+            // Write the binary image. Returns the number of bytes written or 0 if the buffer is too small.
+            uint32_t save(uint8_t *data, const uint32_t size) const
+            {
+                if(data == nullptr || size < IMAGE_SIZE)
+                    return 0;
+
+                data[0] = 'T';
+                data[1] = 'F';
+                data[2] = 'C';
+                data[3] = 'L';
+                data[4] = VERSION;
+                data[5] = m_reading_shift;
+                data[6] = m_strength_shift;
+                data[7] = 0;
+                writeU16(data + 8, ReadingBins);
+                writeU16(data + 10, StrengthBins);
+
+                uint8_t *entry = data + HEADER_SIZE;
+                for(uint8_t mode = 0; mode < 2; ++mode)
+                    for(uint16_t r = 0; r < ReadingBins; ++r)
+                        for(uint16_t s = 0; s < StrengthBins; ++s, entry += 2)
+                            writeU16(entry, uint16_t(m_table[mode][r][s]));
+
+                return IMAGE_SIZE;
+            }
+
+            int16_t correction(const uint16_t reading, const uint16_t strength, const bool short_distance) const
+            {
+                return m_table[short_distance ? 1 : 0][bin(reading, m_reading_shift, ReadingBins)]
+                                                      [bin(strength, m_strength_shift, StrengthBins)];
+            }
+
+            void apply(Measurement *measure) const
+            {
+                // Out of range readings carry no distance to correct
+                if(measure == nullptr || measure->reading == 0xFFFF)
+                    return;
+
+                const int32_t value = int32_t(measure->reading) +
+                                      correction(measure->reading, measure->strength, measure->short_distance);
+
+                measure->reading = value < 0 ? 0 : (value > 0xFFFE ? 0xFFFE : uint16_t(value));
+            }
+
+            void apply(Measurement *measures, const uint32_t count) const
+            {
+                if(measures == nullptr)
+                    return;
+
+                for(uint32_t i = 0; i < count; ++i)
+                    apply(&measures[i]);
+            }
+
+            // Pass as a decode hook together with a pointer to the calibration as context
+            static void decodeHook(uint8_t device_id, Measurement *measure, void *context)
+            {
+                (void)device_id;
+
+                if(context != nullptr)
+                    static_cast<const Calibration *>(context)->apply(measure);
+            }
+
+        private:
+            static uint16_t bin(const uint16_t value, const uint8_t shift, const uint16_t bins)
+            {
+                const uint16_t index = shift < 16 ? uint16_t(value >> shift) : uint16_t(0);
+                return index < bins ? index : bins - 1;
+            }
+
+            static uint16_t binCenter(const uint16_t index, const uint8_t shift)
+            {
+                const uint32_t center = (uint32_t(index) << shift) + ((uint32_t(1) << shift) >> 1);
+                return center > 0xFFFE ? 0xFFFE : uint16_t(center);
+            }
+
+            static int16_t saturate(const float value)
+            {
+                if(value >= 32767.0f)
+                    return 32767;
+                if(value <= -32768.0f)
+                    return -32768;
+
+                return int16_t(value);
+            }
+
+            static uint16_t readU16(const uint8_t *data)
+            {
+                return uint16_t(data[0] | (data[1] << 8));
+            }
+
+            static void writeU16(uint8_t *data, const uint16_t value)
+            {
+                data[0] = value & 0x00FF;
+                data[1] = (value & 0xFF00) >> 8;
+            }
+
+            uint8_t m_reading_shift;
+            uint8_t m_strength_shift;
+            int16_t m_table[2][ReadingBins][StrengthBins]{};
+    };
+}
+
+#endif // TFMINI_CALIB_H
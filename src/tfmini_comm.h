@@ -22,6 +22,7 @@
 #define TFMINI_COMM_H
 
 #include "tfmini_defs.h"
+#include "tfmini_trace.h"
 
 namespace tfmini
 {
@@ -34,39 +35,160 @@ namespace tfmini
                 STATUS_ERROR_INSTRUCTION = 0xFF,
                 STATUS_ERROR_PARAMETER = 0x0F,
                 STATUS_ERROR_TRANSMISSION = 0x02,
+                STATUS_ERROR_TIMEOUT = 0x03,
             };
 
             Comm::Status sendCommand(const uint8_t *cmd)
             {
-                if(m_phy_receive == nullptr || m_phy_send == nullptr || cmd == nullptr)
+                if(m_phy_receive == nullptr)
                     return Comm::STATUS_ERROR_TRANSMISSION;
 
+                return transceiveCommand(cmd, nullptr);
+            }
+
+            // Same as sendCommand(cmd), but gives up with STATUS_ERROR_TIMEOUT once the deadline has passed.
+            // Requires a receive_until_t transport.
+            Comm::Status sendCommand(const uint8_t *cmd, const uint32_t deadline)
+            {
+                if(m_phy_receive_until == nullptr)
+                    return Comm::STATUS_ERROR_TRANSMISSION;
+
+                return transceiveCommand(cmd, &deadline);
+            }
+
+            bool readMeasure(tfmini::Measurement *measure)
+            {
+                if(m_phy_receive == nullptr)
+                    return false;
+
+                return receiveMeasure(measure, nullptr) == STATUS_SUCCESS;
+            }
+
+            // Same as readMeasure(measure), but returns STATUS_ERROR_TIMEOUT as soon as the deadline has passed
+            // instead of waiting for every search byte. Requires a receive_until_t transport.
+            Comm::Status readMeasure(tfmini::Measurement *measure, const uint32_t deadline)
+            {
+                if(m_phy_receive_until == nullptr)
+                    return Comm::STATUS_ERROR_TRANSMISSION;
+
+                return receiveMeasure(measure, &deadline);
+            }
+
+            // Install a function that post-processes every valid measurement in the decode path, e.g. calibration
+            void setDecodeHook(decode_hook_t hook, void *context = nullptr)
+            {
+                m_decode_hook = hook;
+                m_decode_context = context;
+            }
+
+            int16_t getMaxSearchBytes() const
+            {
+                return m_max_search_bytes;
+            }
+
+            void setMaxSearchBytes(const int16_t value)
+            {
+                if(value <= 0)
+                    m_max_search_bytes = 1;
+
+                m_max_search_bytes = value;
+            }
+
+        protected:
+            Comm(const Comm &&) = delete;
+            Comm &operator=(const Comm &) = delete;
+            ~Comm() =default;
+
+            Comm(tfmini::uint8_t device_id, send_t send, receive_t receive):
+                m_device_id{device_id},
+                m_phy_send{send},
+                m_phy_receive{receive}
+            {
+
+            }
+
+            Comm(tfmini::uint8_t device_id, send_t send, receive_t receive, receive_until_t receive_until):
+                m_device_id{device_id},
+                m_phy_send{send},
+                m_phy_receive{receive},
+                m_phy_receive_until{receive_until}
+            {
+
+            }
+
+            uint8_t         m_device_id;
+            send_t          m_phy_send{nullptr};
+            receive_t       m_phy_receive{nullptr};
+            receive_until_t m_phy_receive_until{nullptr};
+            int16_t         m_max_search_bytes{50};
+            decode_hook_t   m_decode_hook{nullptr};
+            void           *m_decode_context{nullptr};
+
+        private:
+            // Receive through the bounded transport when a deadline is given, otherwise through the plain one.
+            // Returns the number of bytes actually read.
+            int16_t phyReceive(uint8_t *buffer, const int16_t len, const uint32_t *deadline)
+            {
+                TFMINI_TRACE_SCOPE(trace, EVENT_PHY_RECEIVE, m_device_id, 0);
+
+                if(deadline == nullptr)
+                {
+                    m_phy_receive(m_device_id, buffer, len);
+                    TFMINI_TRACE_VALUE(trace, len);
+                    return len;
+                }
+
+                const int16_t num_read = m_phy_receive_until(m_device_id, buffer, len, *deadline);
+                TFMINI_TRACE_VALUE(trace, num_read);
+                return num_read;
+            }
+
+            Comm::Status transceiveCommand(const uint8_t *cmd, const uint32_t *deadline)
+            {
+                if(m_phy_send == nullptr || cmd == nullptr)
+                    return Comm::STATUS_ERROR_TRANSMISSION;
+
+                TFMINI_TRACE_SCOPE(trace, EVENT_SEND_COMMAND, m_device_id, 0);
+                const Comm::Status status = exchangeCommand(cmd, deadline);
+                TFMINI_TRACE_VALUE(trace, status);
+                return status;
+            }
+
+            Comm::Status exchangeCommand(const uint8_t *cmd, const uint32_t *deadline)
+            {
                 auto search_magic_header_retry = m_max_search_bytes;
 
-                m_phy_send(m_device_id, cmd, 8);
+                {
+                    TFMINI_TRACE_SCOPE(trace_send, EVENT_PHY_SEND, m_device_id, 8);
+                    m_phy_send(m_device_id, cmd, 8);
+                }
 
                 while(--search_magic_header_retry)
                 {
                     uint8_t byte = 0;
-                    m_phy_receive(m_device_id, &byte, 1);
+                    if(phyReceive(&byte, 1, deadline) != 1)
+                        return Comm::STATUS_ERROR_TIMEOUT;
                     // If first byte is not magic then continue searching
                     if(byte != 0x42)
                         continue;
 
                     byte = 0;
-                    m_phy_receive(m_device_id, &byte, 1);
+                    if(phyReceive(&byte, 1, deadline) != 1)
+                        return Comm::STATUS_ERROR_TIMEOUT;
                     // If second byte is not magic then continue searching
                     if(byte != 0x57)
                         continue;
 
                     byte = 0;
-                    m_phy_receive(m_device_id, &byte, 1);
+                    if(phyReceive(&byte, 1, deadline) != 1)
+                        return Comm::STATUS_ERROR_TIMEOUT;
                     // If third byte is not 0x02 then continue searching
                     if(byte != 0x02)
                         continue;
 
                     byte = 0;
-                    m_phy_receive(m_device_id, &byte, 1);
+                    if(phyReceive(&byte, 1, deadline) != 1)
+                        return Comm::STATUS_ERROR_TIMEOUT;
 
                     if(     byte == Status::STATUS_SUCCESS ||
                             byte == Status::STATUS_ERROR_INSTRUCTION ||
@@ -79,30 +201,35 @@ namespace tfmini
                 return Comm::STATUS_ERROR_TRANSMISSION;
             }
 
-            bool readMeasure(tfmini::Measurement *measure)
+            Comm::Status receiveMeasure(tfmini::Measurement *measure, const uint32_t *deadline)
             {
-                if(m_phy_receive == nullptr || measure == nullptr)
-                    return false;
+                if(measure == nullptr)
+                    return Comm::STATUS_ERROR_TRANSMISSION;
 
                 auto search_magic_header_retry = m_max_search_bytes;
 
                 while(--search_magic_header_retry)
                 {
                     uint8_t byte = 0;
-                    m_phy_receive(m_device_id, &byte, 1);
+                    if(phyReceive(&byte, 1, deadline) != 1)
+                        return Comm::STATUS_ERROR_TIMEOUT;
                     // If first byte is not magic then continue searching
                     if(byte!=0x59)
                         continue;
 
                     byte = 0;
-                    m_phy_receive(m_device_id, &byte, 1);
+                    if(phyReceive(&byte, 1, deadline) != 1)
+                        return Comm::STATUS_ERROR_TIMEOUT;
                     // If second byte is not magic then continue searching
                     if(byte!=0x59)
                         continue;
 
                     uint8_t reading[7];
                     // Read the rest of the command
-                    m_phy_receive(m_device_id, reading, 7);
+                    if(phyReceive(reading, 7, deadline) != 7)
+                        return Comm::STATUS_ERROR_TIMEOUT;
+
+                    TFMINI_TRACE_SCOPE(trace, EVENT_DECODE, m_device_id, 0);
 
                     if(reading[0] == 0xFF && reading[1] == 0xFF)
                         measure->reading = 0xFFFF;
@@ -127,43 +254,17 @@ namespace tfmini
 
                     // Invalid command checksum or invalid distance measure
                     if(!measure->checksum || measure->reading == 0xFFFF)
-                        return false;
-
-                    return true;
-                }
-                return false;
-            }
+                        return Comm::STATUS_ERROR_TRANSMISSION;
 
-            int16_t getMaxSearchBytes() const
-            {
-                return m_max_search_bytes;
-            }
+                    if(m_decode_hook != nullptr)
+                        m_decode_hook(m_device_id, measure, m_decode_context);
 
-            void setMaxSearchBytes(const int16_t value)
-            {
-                if(value <= 0)
-                    m_max_search_bytes = 1;
-
-                m_max_search_bytes = value;
-            }
-
-        protected:
-            Comm(const Comm &&) = delete;
-            Comm &operator=(const Comm &) = delete;
-            ~Comm() =default;
-
-            Comm(tfmini::uint8_t device_id, send_t send, receive_t receive):
-                m_device_id{device_id},
-                m_phy_send{send},
-                m_phy_receive{receive}
-            {
+                    TFMINI_TRACE_VALUE(trace, measure->reading);
 
+                    return Comm::STATUS_SUCCESS;
+                }
+                return Comm::STATUS_ERROR_TRANSMISSION;
             }
-
-            uint8_t   m_device_id;
-            send_t    m_phy_send{nullptr};
-            receive_t m_phy_receive{nullptr};
-            int16_t   m_max_search_bytes{50};
     };
 }
 #endif // TFMINI_COMM_H
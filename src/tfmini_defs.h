@@ -28,6 +28,10 @@ namespace tfmini
     using int8_t   = char;
     using uint16_t = unsigned short;
     using int16_t  = short;
+    using uint32_t = unsigned int;
+    using int32_t  = int;
+    using int64_t  = long long;
+    using uint64_t = unsigned long long;
 
     // Structure to hold a measurement
     struct Measurement
@@ -38,10 +42,27 @@ namespace tfmini
             bool     checksum       {false};
     };
 
+    // Measurement tagged with the time it was received, in the user's own clock
+    struct TimedMeasurement
+    {
+            uint32_t    timestamp {0};
+            Measurement measure;
+    };
+
     // Definition of the functions responsible for the low level send and receive
     using send_t    = void (*)(uint8_t device_id, const uint8_t *buffer, int16_t len);
     using receive_t = void (*)(uint8_t device_id,       uint8_t *buffer, int16_t len);
 
+    // Deadline bounded receive. Reads up to len bytes and returns as soon as all of them arrived or the absolute
+    // deadline, expressed in the transport's own clock, has passed. Returns the number of bytes actually read.
+    using receive_until_t = int16_t (*)(uint8_t device_id, uint8_t *buffer, int16_t len, uint32_t deadline);
+
+    // Microsecond timestamp source
+    using clock_source_t = uint32_t (*)();
+
+    // Called for every valid measurement right after it is decoded. It may modify the measurement in place.
+    using decode_hook_t = void (*)(uint8_t device_id, Measurement *measure, void *context);
+
     // Configuration commands
     enum Command : uint8_t
     {
@@ -63,6 +84,25 @@ namespace tfmini
         EXIT_COMMAND_MODE
     };
 
+    // Instruction code of every command, indexed by Command
+    inline constexpr uint8_t instruction_codes[]
+    {
+        0x06, 0x07, 0x1A, 0x14, 0x11, 0x19, 0x20, 0x21,
+        0x08, 0x40, 0x41, 0xFF,
+        0x02, 0x02
+    };
+
+    // Configuration frame: 0x42 0x57 0x02 0x00, three parameter bytes and the instruction code
+    struct Frame
+    {
+            uint8_t bytes[8];
+    };
+
+    constexpr Frame makeFrame(const Command cmd, const uint8_t p0 = 0x00, const uint8_t p1 = 0x00, const uint8_t p2 = 0x00)
+    {
+        return Frame{{0x42, 0x57, 0x02, 0x00, p0, p1, p2, instruction_codes[cmd]}};
+    }
+
     enum OutputDataFormat : uint8_t
     {
         FORMAT_DEFAULT  = 0x01,
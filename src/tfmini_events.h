@@ -0,0 +1,293 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_EVENTS_H
+#define TFMINI_EVENTS_H
+
+#include <atomic>
+
+#include "tfmini_defs.h"
+#include "tfmini_ring.h"
+
+namespace tfmini
+{
+    enum RuleType : uint8_t
+    {
+        RULE_ZONE         = 0x00,   // Reading inside [low, high]
+        RULE_APPROACH     = 0x01,   // Reading decreasing faster than `high` units per second
+        RULE_STRENGTH_LOW = 0x02    // Strength below `low`
+    };
+
+    enum EventType : uint8_t
+    {
+        EVENT_ZONE_ENTER     = 0x00,
+        EVENT_ZONE_EXIT      = 0x01,
+        EVENT_APPROACH_START = 0x02,
+        EVENT_APPROACH_END   = 0x03,
+        EVENT_STRENGTH_LOW   = 0x04,
+        EVENT_STRENGTH_OK    = 0x05
+    };
+
+    // Threshold rule. A rule becomes active when its condition holds and inactive only when the condition is off
+    // by more than the hysteresis. Either change must be seen on `debounce` consecutive measurements.
+    struct Rule
+    {
+            RuleType type       {RULE_ZONE};
+            uint16_t low        {0};
+            uint16_t high       {0};
+            uint16_t hysteresis {0};
+            uint8_t  debounce   {1};
+
+            static Rule zone(const uint16_t near_limit, const uint16_t far_limit, const uint16_t hysteresis, const uint8_t debounce)
+            {
+                return Rule{RULE_ZONE, near_limit, far_limit, hysteresis, debounce};
+            }
+
+            static Rule approach(const uint16_t rate, const uint16_t hysteresis, const uint8_t debounce)
+            {
+                return Rule{RULE_APPROACH, 0, rate, hysteresis, debounce};
+            }
+
+            static Rule strengthLow(const uint16_t threshold, const uint16_t hysteresis, const uint8_t debounce)
+            {
+                return Rule{RULE_STRENGTH_LOW, threshold, 0, hysteresis, debounce};
+            }
+    };
+
+    struct Event
+    {
+            uint32_t  decoded  {0};     // Clock value when the triggering measurement was decoded
+            uint16_t  reading  {0};
+            uint16_t  strength {0};
+            uint8_t   device   {0};
+            uint8_t   rule     {0};     // Index of the rule in the order it was added
+            EventType type     {EVENT_ZONE_ENTER};
+    };
+
+    using event_callback_t = void (*)(const Event &event, void *context);
+
+    // Evaluates threshold rules on every measurement of one sensor, directly in the decode path when installed as
+    // a decode hook. Events are passed to the callback, if any, from the decoding thread and posted to a lock-free
+    // queue for another thread to pop.
+    //
+    // Comm holds a single decode hook. To combine the engine with another hook, e.g. Calibration::decodeHook, set
+    // that one as the upstream hook of the engine and install the engine. The rules then see its output.
+    //
+    // The clock is sampled once per measurement. Subtract Event::decoded from the time the event is handled to get
+    // the decode to event latency. The latency up to the callback returning is tracked by the engine.
+    template<uint8_t MaxRules = 8, uint16_t QueueDepth = 64>
+    class EventEngine
+    {
+        public:
+            explicit EventEngine(clock_source_t clock):
+                m_clock{clock}
+            {
+            }
+
+            EventEngine(const EventEngine &) = delete;
+            EventEngine &operator=(const EventEngine &) = delete;
+
+            // Returns false if there is no room for more rules
+            bool addRule(const Rule &rule)
+            {
+                if(m_rule_count >= MaxRules)
+                    return false;
+
+                m_rules[m_rule_count] = rule;
+                m_state[m_rule_count] = State{};
+                ++m_rule_count;
+                return true;
+            }
+
+            void setCallback(event_callback_t callback, void *context = nullptr)
+            {
+                m_callback = callback;
+                m_callback_context = context;
+            }
+
+            // Hook run on every measurement before the rules are evaluated, nullptr removes it
+            void setUpstreamHook(decode_hook_t hook, void *context = nullptr)
+            {
+                m_upstream = hook;
+                m_upstream_context = context;
+            }
+
+            void evaluate(const uint8_t device, const Measurement &measure)
+            {
+                const uint32_t now = m_clock != nullptr ? m_clock() : 0;
+                const bool has_reading = measure.reading != 0xFFFF;
+
+                for(uint8_t i = 0; i < m_rule_count; ++i)
+                {
+                    const Rule &rule = m_rules[i];
+                    State &state = m_state[i];
+                    bool condition = state.active;
+
+                    switch(rule.type)
+                    {
+                        case RULE_ZONE:
+                            if(!has_reading)
+                                continue;
+
+                            if(state.active)
+                                condition = measure.reading + rule.hysteresis >= rule.low && measure.reading <= rule.high + rule.hysteresis;
+                            else
+                                condition = measure.reading >= rule.low && measure.reading <= rule.high;
+                            break;
+
+                        case RULE_APPROACH:
+                        {
+                            if(!has_reading)
+                                continue;
+
+                            const bool had_reading = state.has_previous;
+                            const int64_t closing = int64_t(state.previous_reading) - measure.reading;
+                            const int64_t elapsed = int64_t(uint32_t(now - state.previous_time));
+
+                            state.previous_reading = measure.reading;
+                            state.previous_time = now;
+                            state.has_previous = true;
+
+                            if(!had_reading || elapsed <= 0)
+                                continue;
+
+                            // Closing speed in reading units per second, compared without a division. The release
+                            // threshold stays positive, so a stationary target always ends the approach.
+                            int64_t threshold = state.active ? int64_t(rule.high) - rule.hysteresis : rule.high;
+                            if(threshold < 1)
+                                threshold = 1;
+                            condition = closing * 1000000 >= threshold * elapsed;
+                            break;
+                        }
+
+                        case RULE_STRENGTH_LOW:
+                            if(state.active)
+                                condition = measure.strength < uint32_t(rule.low) + rule.hysteresis;
+                            else
+                                condition = measure.strength < rule.low;
+                            break;
+                    }
+
+                    if(condition == state.active)
+                    {
+                        state.count = 0;
+                        continue;
+                    }
+
+                    if(++state.count < rule.debounce)
+                        continue;
+
+                    state.active = condition;
+                    state.count = 0;
+                    post(Event{now, measure.reading, measure.strength, device, i, eventType(rule.type, condition)});
+                }
+            }
+
+            // Pass as a decode hook together with a pointer to the engine as context. Runs the upstream hook first.
+            static void decodeHook(uint8_t device_id, Measurement *measure, void *context)
+            {
+                if(context == nullptr || measure == nullptr)
+                    return;
+
+                EventEngine *engine = static_cast<EventEngine *>(context);
+                if(engine->m_upstream != nullptr)
+                    engine->m_upstream(device_id, measure, engine->m_upstream_context);
+
+                engine->evaluate(device_id, *measure);
+            }
+
+            // Consumer side. Returns false if there is no event.
+            bool pop(Event *event)
+            {
+                return m_queue.pop(event);
+            }
+
+            bool isActive(const uint8_t rule) const
+            {
+                return rule < m_rule_count && m_state[rule].active;
+            }
+
+            // Longest time from decoding a measurement until its event was posted and the callback returned
+            uint32_t getMaxLatency() const
+            {
+                return m_max_latency.load(std::memory_order_relaxed);
+            }
+
+            // Events lost because the queue was full
+            uint32_t getDroppedEvents() const
+            {
+                return m_dropped.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct State
+            {
+                    bool     active           {false};
+                    uint8_t  count            {0};
+                    bool     has_previous     {false};
+                    uint16_t previous_reading {0};
+                    uint32_t previous_time    {0};
+            };
+
+            static EventType eventType(const RuleType type, const bool active)
+            {
+                switch(type)
+                {
+                    case RULE_ZONE:         return active ? EVENT_ZONE_ENTER : EVENT_ZONE_EXIT;
+                    case RULE_APPROACH:     return active ? EVENT_APPROACH_START : EVENT_APPROACH_END;
+                    case RULE_STRENGTH_LOW: return active ? EVENT_STRENGTH_LOW : EVENT_STRENGTH_OK;
+                }
+
+                return EVENT_ZONE_ENTER;
+            }
+
+            void post(const Event &event)
+            {
+                if(m_callback != nullptr)
+                    m_callback(event, m_callback_context);
+
+                if(!m_queue.push(event))
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+
+                if(m_clock == nullptr)
+                    return;
+
+                const uint32_t latency = m_clock() - event.decoded;
+                if(latency > m_max_latency.load(std::memory_order_relaxed))
+                    m_max_latency.store(latency, std::memory_order_relaxed);
+            }
+
+            clock_source_t   m_clock;
+            event_callback_t m_callback{nullptr};
+            void            *m_callback_context{nullptr};
+            decode_hook_t    m_upstream{nullptr};
+            void            *m_upstream_context{nullptr};
+
+            Rule    m_rules[MaxRules];
+            State   m_state[MaxRules];
+            uint8_t m_rule_count{0};
+
+            SpscRing<Event, QueueDepth> m_queue;
+            std::atomic<uint32_t>       m_max_latency{0};
+            std::atomic<uint32_t>       m_dropped{0};
+    };
+}
+
+#endif // TFMINI_EVENTS_H
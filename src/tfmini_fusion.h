@@ -0,0 +1,315 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_FUSION_H
+#define TFMINI_FUSION_H
+
+#include "tfmini_defs.h"
+#include "tfmini_ring.h"
+
+namespace tfmini
+{
+    enum Interpolation : uint8_t
+    {
+        INTERPOLATION_LINEAR = 0x00,
+        INTERPOLATION_NEAREST = 0x01
+    };
+
+    // Measurements of all sensors at one tick of the common timeline
+    template<uint8_t Sensors>
+    struct AlignedFrame
+    {
+            uint32_t    timestamp {0};
+            uint32_t    valid     {0};      // Bit N is set if measure[N] holds a value
+            Measurement measure[Sensors];
+    };
+
+    // Aligns the timestamped streams of several sensors onto a common timeline with a fixed period.
+    //
+    // Every sensor pushes its measurements, from its own thread, into a lock-free queue. process() merges the queues
+    // in timestamp order and resamples the merged stream at every tick, either by linear interpolation between the
+    // two samples around the tick or by taking the nearer one. Samples further than max_gap from the tick are not
+    // used. A tick waits at most max_latency for all sensors, after that it is emitted with the sensors that did
+    // not deliver marked as invalid, so a sensor that drops out does not stall the others.
+    //
+    // Aligned frames are stored in a preallocated buffer. If the consumer does not keep up, the oldest frames are
+    // overwritten.
+    template<uint8_t Sensors, uint16_t InputDepth = 64, uint16_t OutputDepth = 64>
+    class Fusion
+    {
+            static_assert(Sensors > 0 && Sensors <= 32, "Between 1 and 32 sensors are supported");
+            static_assert(OutputDepth > 1, "At least two output frames are needed");
+
+        public:
+            using frame_t = AlignedFrame<Sensors>;
+
+            Fusion(const uint32_t period, const uint32_t max_latency, const uint32_t max_gap,
+                   const Interpolation interpolation = INTERPOLATION_LINEAR):
+                m_period{period == 0 ? 1 : period},
+                m_max_latency{max_latency},
+                m_max_gap{max_gap},
+                m_interpolation{interpolation}
+            {
+            }
+
+            Fusion(const Fusion &) = delete;
+            Fusion &operator=(const Fusion &) = delete;
+
+            // Producer side, one thread per sensor. Returns false if the queue of the sensor is full.
+            bool push(const uint8_t sensor, const TimedMeasurement &measure)
+            {
+                if(sensor >= Sensors)
+                    return false;
+
+                return m_input[sensor].push(measure);
+            }
+
+            // Consumer side. Merges the queued samples and emits every tick that is complete or older than
+            // now - max_latency. Returns the number of emitted frames.
+            uint16_t process(const uint32_t now)
+            {
+                const uint32_t committed = m_commit;
+
+                while(true)
+                {
+                    uint8_t  next = Sensors;
+                    uint32_t next_timestamp = 0;
+                    uint32_t empty = 0;
+
+                    // k-way merge: pick the oldest head among the sensor queues
+                    for(uint8_t i = 0; i < Sensors; ++i)
+                    {
+                        const TimedMeasurement *head = m_input[i].front();
+                        if(head == nullptr)
+                        {
+                            empty |= uint32_t(1) << i;
+                            continue;
+                        }
+
+                        if(next == Sensors || int32_t(head->timestamp - next_timestamp) < 0)
+                        {
+                            next = i;
+                            next_timestamp = head->timestamp;
+                        }
+                    }
+
+                    if(next == Sensors || isWaiting(empty, next_timestamp, now))
+                        break;
+
+                    TimedMeasurement sample;
+                    m_input[next].pop(&sample);
+                    ingest(next, sample);
+                }
+
+                // Give up waiting for the sensors that did not deliver in time
+                while(m_commit != m_write && int32_t(now - m_frames[m_commit % OutputDepth].timestamp) >= int32_t(m_max_latency))
+                    finalize(m_commit++ % OutputDepth);
+
+                return uint16_t(m_commit - committed);
+            }
+
+            // Consumer side. Returns false if there is no aligned frame.
+            bool pop(frame_t *frame)
+            {
+                if(frame == nullptr || m_read == m_commit)
+                    return false;
+
+                *frame = m_frames[m_read++ % OutputDepth];
+                return true;
+            }
+
+            // Frames overwritten before they were popped
+            uint32_t getOverruns() const
+            {
+                return m_overruns;
+            }
+
+            // Samples that arrived after their place on the timeline had already been passed
+            uint32_t getLateSamples() const
+            {
+                return m_late;
+            }
+
+        private:
+            static constexpr uint32_t ALL_SENSORS = Sensors == 32 ? 0xFFFFFFFFu : ((uint32_t(1) << Sensors) - 1);
+
+            // A sensor with an empty queue may still deliver a sample older than the merge candidate. Wait for it,
+            // unless it has been silent for longer than max_latency.
+            bool isWaiting(const uint32_t empty, const uint32_t candidate, const uint32_t now) const
+            {
+                for(uint8_t sensor = 0; sensor < Sensors; ++sensor)
+                {
+                    const uint32_t bit = uint32_t(1) << sensor;
+                    if((empty & bit) == 0)
+                        continue;
+
+                    const uint32_t seen = (m_has_last & bit) != 0 ? m_last[sensor].timestamp : candidate;
+                    if(int32_t(now - seen) < int32_t(m_max_latency))
+                        return true;
+                }
+
+                return false;
+            }
+
+            void ingest(const uint8_t sensor, const TimedMeasurement &sample)
+            {
+                if(m_started && int32_t(sample.timestamp - m_merge_time) < 0)
+                {
+                    ++m_late;
+                    return;
+                }
+
+                if(!m_started)
+                {
+                    // First tick on the first multiple of the period
+                    m_next_tick = ((sample.timestamp + m_period - 1) / m_period) * m_period;
+                    m_started = true;
+                }
+
+                m_merge_time = sample.timestamp;
+
+                while(int32_t(sample.timestamp - m_next_tick) >= 0)
+                {
+                    createFrame(m_next_tick);
+                    m_next_tick += m_period;
+                }
+
+                const uint32_t bit = uint32_t(1) << sensor;
+                for(uint32_t i = m_commit; i != m_write; ++i)
+                {
+                    const uint16_t index = i % OutputDepth;
+                    if((m_filled[index] & bit) == 0 && int32_t(sample.timestamp - m_frames[index].timestamp) >= 0)
+                    {
+                        resample(index, sensor, sample);
+                        m_filled[index] |= bit;
+                    }
+                }
+
+                m_last[sensor] = sample;
+                m_has_last |= bit;
+
+                // Frames complete in order, because a sample fills every older pending tick as well
+                while(m_commit != m_write && m_filled[m_commit % OutputDepth] == ALL_SENSORS)
+                    ++m_commit;
+            }
+
+            void createFrame(const uint32_t timestamp)
+            {
+                // The buffer is full: drop the oldest frame nobody popped, or emit the oldest pending one as it is
+                if(m_write - m_read == OutputDepth)
+                {
+                    if(m_read == m_commit)
+                        finalize(m_commit++ % OutputDepth);
+
+                    ++m_read;
+                    ++m_overruns;
+                }
+
+                const uint16_t index = m_write++ % OutputDepth;
+                m_frames[index].timestamp = timestamp;
+                m_frames[index].valid = 0;
+                m_filled[index] = 0;
+            }
+
+            // Value of a sensor at the tick, from the samples before (if any) and at/after it
+            void resample(const uint16_t index, const uint8_t sensor, const TimedMeasurement &after)
+            {
+                frame_t &frame = m_frames[index];
+                const uint32_t bit = uint32_t(1) << sensor;
+                const uint32_t to_after = after.timestamp - frame.timestamp;
+
+                if((m_has_last & bit) == 0)
+                {
+                    store(frame, sensor, after.measure, to_after <= m_max_gap);
+                    return;
+                }
+
+                const TimedMeasurement &before = m_last[sensor];
+                const uint32_t to_before = frame.timestamp - before.timestamp;
+
+                if(m_interpolation == INTERPOLATION_NEAREST || to_before + to_after > m_max_gap || to_before + to_after == 0)
+                {
+                    if(to_before < to_after)
+                        store(frame, sensor, before.measure, to_before <= m_max_gap);
+                    else
+                        store(frame, sensor, after.measure, to_after <= m_max_gap);
+                    return;
+                }
+
+                const uint32_t span = to_before + to_after;
+                Measurement value = to_before < to_after ? before.measure : after.measure;
+                value.reading  = uint16_t((uint32_t(before.measure.reading) * to_after + uint32_t(after.measure.reading) * to_before + span / 2) / span);
+                value.strength = uint16_t((uint32_t(before.measure.strength) * to_after + uint32_t(after.measure.strength) * to_before + span / 2) / span);
+                store(frame, sensor, value, true);
+            }
+
+            // Fill the sensors that did not deliver after the tick with their last sample, if it is close enough
+            void finalize(const uint16_t index)
+            {
+                frame_t &frame = m_frames[index];
+
+                for(uint8_t sensor = 0; sensor < Sensors; ++sensor)
+                {
+                    const uint32_t bit = uint32_t(1) << sensor;
+                    if((m_filled[index] & bit) != 0)
+                        continue;
+
+                    const bool close = (m_has_last & bit) != 0 && frame.timestamp - m_last[sensor].timestamp <= m_max_gap;
+                    store(frame, sensor, m_last[sensor].measure, close);
+                    m_filled[index] |= bit;
+                }
+            }
+
+            static void store(frame_t &frame, const uint8_t sensor, const Measurement &measure, const bool valid)
+            {
+                const uint32_t bit = uint32_t(1) << sensor;
+                frame.measure[sensor] = valid ? measure : Measurement{};
+
+                if(valid)
+                    frame.valid |= bit;
+                else
+                    frame.valid &= ~bit;
+            }
+
+            SpscRing<TimedMeasurement, InputDepth> m_input[Sensors];
+
+            frame_t  m_frames[OutputDepth];
+            uint32_t m_filled[OutputDepth]{};  // Sensors resampled into each pending frame
+            uint32_t m_read{0};         // Next frame to pop
+            uint32_t m_commit{0};       // Frames before this one are complete
+            uint32_t m_write{0};        // Next frame to create
+
+            TimedMeasurement m_last[Sensors];
+            uint32_t m_has_last{0};
+            uint32_t m_merge_time{0};
+            uint32_t m_next_tick{0};
+            bool     m_started{false};
+
+            uint32_t m_period;
+            uint32_t m_max_latency;
+            uint32_t m_max_gap;
+            Interpolation m_interpolation;
+
+            uint32_t m_overruns{0};
+            uint32_t m_late{0};
+    };
+}
+
+#endif // TFMINI_FUSION_H
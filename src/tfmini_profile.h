@@ -0,0 +1,217 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_PROFILE_H
+#define TFMINI_PROFILE_H
+
+#include "tfmini_defs.h"
+
+namespace tfmini
+{
+    // Typed sensor configuration. Only the settings whose bit is set in `fields` are part of the profile, the rest
+    // are unknown or don't care.
+    struct Profile
+    {
+            enum Field : uint16_t
+            {
+                FIELD_NONE          = 0x0000,
+                FIELD_FORMAT        = 0x0001,
+                FIELD_PERIOD        = 0x0002,
+                FIELD_UNIT          = 0x0004,
+                FIELD_PATTERN       = 0x0008,
+                FIELD_MODE          = 0x0010,
+                FIELD_RANGE_LIMIT   = 0x0020,
+                FIELD_STRENGTH_LOW  = 0x0040,
+                FIELD_STRENGTH_HI   = 0x0080,
+                FIELD_BAUD_RATE     = 0x0100,
+                FIELD_TRIGGER       = 0x0200,
+                FIELD_ALL           = 0x03FF
+            };
+
+            static constexpr uint8_t  VERSION = 1;
+            static constexpr uint16_t SERIALIZED_SIZE = 16;
+
+            uint16_t         fields       {FIELD_NONE};
+            OutputDataFormat format       {FORMAT_DEFAULT};
+            uint16_t         period_ms    {10};
+            DistanceUnit     unit         {UNIT_DEFAULT};
+            DetectionPattern pattern      {DETECTION_DEFAULT};
+            DistanceMode     mode         {DISTANCE_SHORT_16X};
+            uint16_t         range_mm     {0};
+            uint8_t          strength_low {0};
+            uint16_t         strength_hi  {0};
+            BaudRate         baud_rate    {BAUD_115200};
+            TriggerSrc       trigger      {TRIGGER_INT};
+
+            Profile &setOutputDataFormat(const OutputDataFormat value)
+            {
+                format = value;
+                fields |= FIELD_FORMAT;
+                return *this;
+            }
+
+            Profile &setOutputPeriod(const uint16_t value)
+            {
+                period_ms = value;
+                fields |= FIELD_PERIOD;
+                return *this;
+            }
+
+            Profile &setDistanceUnit(const DistanceUnit value)
+            {
+                unit = value;
+                fields |= FIELD_UNIT;
+                return *this;
+            }
+
+            Profile &setDetectionPattern(const DetectionPattern value)
+            {
+                pattern = value;
+                fields |= FIELD_PATTERN;
+                return *this;
+            }
+
+            Profile &setDistanceMode(const DistanceMode value)
+            {
+                mode = value;
+                fields |= FIELD_MODE;
+                return *this;
+            }
+
+            Profile &setRangeLimit(const uint16_t value)
+            {
+                range_mm = value;
+                fields |= FIELD_RANGE_LIMIT;
+                return *this;
+            }
+
+            Profile &setSignalStrengthLow(const uint8_t value)
+            {
+                strength_low = value;
+                fields |= FIELD_STRENGTH_LOW;
+                return *this;
+            }
+
+            Profile &setSignalStrengthHi(const uint16_t value)
+            {
+                strength_hi = value;
+                fields |= FIELD_STRENGTH_HI;
+                return *this;
+            }
+
+            Profile &setBaudRate(const BaudRate value)
+            {
+                baud_rate = value;
+                fields |= FIELD_BAUD_RATE;
+                return *this;
+            }
+
+            Profile &setTriggerSrc(const TriggerSrc value)
+            {
+                trigger = value;
+                fields |= FIELD_TRIGGER;
+                return *this;
+            }
+
+            bool has(const Field field) const
+            {
+                return (fields & field) != 0;
+            }
+
+            // Fields set in this profile which are either unknown in `other` or hold a different value
+            uint16_t diff(const Profile &other) const
+            {
+                uint16_t changed = fields & ~other.fields;
+                const uint16_t common = fields & other.fields;
+
+                if((common & FIELD_FORMAT)       && format != other.format)             changed |= FIELD_FORMAT;
+                if((common & FIELD_PERIOD)       && period_ms != other.period_ms)       changed |= FIELD_PERIOD;
+                if((common & FIELD_UNIT)         && unit != other.unit)                 changed |= FIELD_UNIT;
+                if((common & FIELD_PATTERN)      && pattern != other.pattern)           changed |= FIELD_PATTERN;
+                if((common & FIELD_MODE)         && mode != other.mode)                 changed |= FIELD_MODE;
+                if((common & FIELD_RANGE_LIMIT)  && range_mm != other.range_mm)         changed |= FIELD_RANGE_LIMIT;
+                if((common & FIELD_STRENGTH_LOW) && strength_low != other.strength_low) changed |= FIELD_STRENGTH_LOW;
+                if((common & FIELD_STRENGTH_HI)  && strength_hi != other.strength_hi)   changed |= FIELD_STRENGTH_HI;
+                if((common & FIELD_BAUD_RATE)    && baud_rate != other.baud_rate)       changed |= FIELD_BAUD_RATE;
+                if((common & FIELD_TRIGGER)      && trigger != other.trigger)           changed |= FIELD_TRIGGER;
+
+                return changed;
+            }
+
+            bool operator==(const Profile &other) const
+            {
+                return fields == other.fields && diff(other) == 0;
+            }
+
+            bool operator!=(const Profile &other) const
+            {
+                return !(*this == other);
+            }
+
+            // Write the profile in a compact little endian form. Returns the number of bytes written or 0 if the
+            // buffer is too small.
+            uint16_t serialize(uint8_t *data, const uint16_t size) const
+            {
+                if(data == nullptr || size < SERIALIZED_SIZE)
+                    return 0;
+
+                data[0]  = VERSION;
+                data[1]  = fields & 0x00FF;
+                data[2]  = (fields & 0xFF00)>>8;
+                data[3]  = format;
+                data[4]  = period_ms & 0x00FF;
+                data[5]  = (period_ms & 0xFF00)>>8;
+                data[6]  = unit;
+                data[7]  = pattern;
+                data[8]  = mode;
+                data[9]  = range_mm & 0x00FF;
+                data[10] = (range_mm & 0xFF00)>>8;
+                data[11] = strength_low;
+                data[12] = strength_hi & 0x00FF;
+                data[13] = (strength_hi & 0xFF00)>>8;
+                data[14] = baud_rate;
+                data[15] = trigger;
+
+                return SERIALIZED_SIZE;
+            }
+
+            bool deserialize(const uint8_t *data, const uint16_t size)
+            {
+                if(data == nullptr || size < SERIALIZED_SIZE || data[0] != VERSION)
+                    return false;
+
+                fields       = uint16_t(data[1] | (data[2] << 8)) & FIELD_ALL;
+                format       = OutputDataFormat(data[3]);
+                period_ms    = uint16_t(data[4] | (data[5] << 8));
+                unit         = DistanceUnit(data[6]);
+                pattern      = DetectionPattern(data[7]);
+                mode         = DistanceMode(data[8]);
+                range_mm     = uint16_t(data[9] | (data[10] << 8));
+                strength_low = data[11];
+                strength_hi  = uint16_t(data[12] | (data[13] << 8));
+                baud_rate    = BaudRate(data[14]);
+                trigger      = TriggerSrc(data[15]);
+
+                return true;
+            }
+    };
+}
+
+#endif // TFMINI_PROFILE_H
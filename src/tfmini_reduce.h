@@ -0,0 +1,220 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_REDUCE_H
+#define TFMINI_REDUCE_H
+
+#include "tfmini_defs.h"
+
+namespace tfmini
+{
+    enum ReduceMode : uint8_t
+    {
+        REDUCE_NONE      = 0x00,    // Emit every measurement
+        REDUCE_DEADBAND  = 0x01,    // Emit when the reading moved by more than the deadband
+        REDUCE_DECIMATE  = 0x02,    // Emit one aggregated measurement per N inputs
+        REDUCE_HEARTBEAT = 0x03     // Emit one measurement per interval
+    };
+
+    enum Aggregate : uint8_t
+    {
+        AGGREGATE_LAST = 0x00,
+        AGGREGATE_MIN  = 0x01,
+        AGGREGATE_MAX  = 0x02,
+        AGGREGATE_MEAN = 0x03
+    };
+
+    // Reduces the rate of a measurement stream for downstream consumers. Use one per sensor.
+    //
+    // The heartbeat bounds the staleness in the deadband and decimate modes: once `interval` has passed since the
+    // last emitted measurement, the next input is emitted (or the pending aggregate is flushed). The worst case
+    // staleness is therefore the heartbeat interval plus one input period.
+    class Reducer
+    {
+        public:
+            Reducer() = default;
+
+            explicit Reducer(const ReduceMode mode):
+                m_mode{mode}
+            {
+            }
+
+            ReduceMode getMode() const
+            {
+                return m_mode;
+            }
+
+            // Switch the mode, keeping the parameters given to its setter before
+            void setMode(const ReduceMode mode)
+            {
+                m_mode = mode;
+                reset();
+            }
+
+            // Emit only when the reading differs from the last emitted one by more than `deadband`
+            void setDeadband(const uint16_t deadband)
+            {
+                m_mode = REDUCE_DEADBAND;
+                m_deadband = deadband;
+                reset();
+            }
+
+            // Emit one measurement per `factor` inputs, with the reading aggregated over them
+            void setDecimation(const uint16_t factor, const Aggregate aggregate)
+            {
+                m_mode = REDUCE_DECIMATE;
+                m_factor = factor == 0 ? 1 : factor;
+                m_aggregate = aggregate;
+                reset();
+            }
+
+            // Emit the first input after `interval` has passed since the last emitted measurement
+            void setInterval(const uint32_t interval)
+            {
+                m_mode = REDUCE_HEARTBEAT;
+                m_interval = interval;
+                reset();
+            }
+
+            // Maximum time between two emitted measurements, 0 disables the heartbeat
+            void setHeartbeat(const uint32_t interval)
+            {
+                m_heartbeat = interval;
+            }
+
+            // Forget the emitted and aggregated state, so the next input is emitted
+            void reset()
+            {
+                m_emitted = false;
+                m_count = 0;
+            }
+
+            // Feed one measurement. Returns true and fills `out` when a measurement has to be passed downstream.
+            bool push(const TimedMeasurement &in, TimedMeasurement *out)
+            {
+                if(out == nullptr)
+                    return false;
+
+                const int32_t elapsed = int32_t(in.timestamp - m_emit_time);
+                const bool heartbeat = m_emitted && m_heartbeat != 0 && elapsed >= int32_t(m_heartbeat);
+
+                switch(m_mode)
+                {
+                    case REDUCE_DEADBAND:
+                    {
+                        const uint16_t change = in.measure.reading > m_last.measure.reading ?
+                                                in.measure.reading - m_last.measure.reading :
+                                                m_last.measure.reading - in.measure.reading;
+
+                        if(m_emitted && !heartbeat && change <= m_deadband &&
+                           in.measure.short_distance == m_last.measure.short_distance)
+                            return false;
+
+                        return emit(in, in.timestamp, out);
+                    }
+
+                    case REDUCE_DECIMATE:
+                        accumulate(in);
+
+                        if(m_count < m_factor && !heartbeat)
+                            return false;
+
+                        m_count = 0;
+                        return emit(m_window, in.timestamp, out);
+
+                    case REDUCE_HEARTBEAT:
+                        if(m_emitted && elapsed < int32_t(m_interval))
+                            return false;
+                        break;
+
+                    case REDUCE_NONE:
+                        break;
+                }
+
+                return emit(in, in.timestamp, out);
+            }
+
+        private:
+            // The aggregate of a window may carry the timestamp of an older input, so the heartbeat runs from `now`
+            bool emit(const TimedMeasurement &measure, const uint32_t now, TimedMeasurement *out)
+            {
+                *out = measure;
+                m_last = measure;
+                m_emit_time = now;
+                m_emitted = true;
+                return true;
+            }
+
+            void accumulate(const TimedMeasurement &in)
+            {
+                if(m_count == 0)
+                {
+                    m_window = in;
+                    m_sum_reading = 0;
+                    m_sum_strength = 0;
+                }
+
+                ++m_count;
+                m_sum_reading += in.measure.reading;
+                m_sum_strength += in.measure.strength;
+
+                switch(m_aggregate)
+                {
+                    case AGGREGATE_MIN:
+                        if(in.measure.reading <= m_window.measure.reading)
+                            m_window = in;
+                        break;
+
+                    case AGGREGATE_MAX:
+                        if(in.measure.reading >= m_window.measure.reading)
+                            m_window = in;
+                        break;
+
+                    case AGGREGATE_MEAN:
+                        m_window = in;
+                        m_window.measure.reading = uint16_t((m_sum_reading + m_count / 2) / m_count);
+                        m_window.measure.strength = uint16_t((m_sum_strength + m_count / 2) / m_count);
+                        break;
+
+                    case AGGREGATE_LAST:
+                        m_window = in;
+                        break;
+                }
+            }
+
+            ReduceMode m_mode{REDUCE_NONE};
+            Aggregate  m_aggregate{AGGREGATE_LAST};
+            uint16_t   m_deadband{0};
+            uint16_t   m_factor{1};
+            uint32_t   m_interval{0};
+            uint32_t   m_heartbeat{0};
+
+            TimedMeasurement m_last;
+            uint32_t         m_emit_time{0};
+            bool             m_emitted{false};
+
+            TimedMeasurement m_window;
+            uint16_t         m_count{0};
+            uint32_t         m_sum_reading{0};
+            uint32_t         m_sum_strength{0};
+    };
+}
+
+#endif // TFMINI_REDUCE_H
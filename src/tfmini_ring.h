@@ -0,0 +1,90 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_RING_H
+#define TFMINI_RING_H
+
+#include <atomic>
+
+#include "tfmini_defs.h"
+
+namespace tfmini
+{
+    // Lock-free, fixed capacity queue for exactly one producer and one consumer thread
+    template<typename T, uint16_t Capacity>
+    class SpscRing
+    {
+            static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Ring capacity must be a power of two");
+
+        public:
+            SpscRing() = default;
+            SpscRing(const SpscRing &) = delete;
+            SpscRing &operator=(const SpscRing &) = delete;
+
+            // Producer side. Returns false if the ring is full.
+            bool push(const T &item)
+            {
+                const uint32_t head = m_head.load(std::memory_order_relaxed);
+                if(head - m_tail.load(std::memory_order_acquire) == Capacity)
+                    return false;
+
+                m_items[head & (Capacity - 1)] = item;
+                m_head.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            // Consumer side. Returns nullptr if the ring is empty. The item stays valid until pop().
+            const T *front() const
+            {
+                const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+                if(m_head.load(std::memory_order_acquire) == tail)
+                    return nullptr;
+
+                return &m_items[tail & (Capacity - 1)];
+            }
+
+            // Consumer side. Returns false if the ring is empty.
+            bool pop(T *item = nullptr)
+            {
+                const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+                if(m_head.load(std::memory_order_acquire) == tail)
+                    return false;
+
+                if(item != nullptr)
+                    *item = m_items[tail & (Capacity - 1)];
+
+                m_tail.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool empty() const
+            {
+                return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+            }
+
+        private:
+            // Producer and consumer indexes on separate cache lines
+            T                                 m_items[Capacity];
+            alignas(64) std::atomic<uint32_t> m_head{0};
+            alignas(64) std::atomic<uint32_t> m_tail{0};
+    };
+}
+
+#endif // TFMINI_RING_H
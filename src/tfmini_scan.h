@@ -0,0 +1,328 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_SCAN_H
+#define TFMINI_SCAN_H
+
+#include <atomic>
+
+#include "tfmini_defs.h"
+
+namespace tfmini
+{
+    // Angle of the scanning mechanism at a given timestamp, when it follows a known (commanded) profile
+    using angle_profile_t = float (*)(uint32_t timestamp);
+
+    // Single sample of a sweep
+    struct ScanPoint
+    {
+            uint32_t    timestamp {0};
+            float       angle     {0};
+            Measurement measure;
+    };
+
+    // All the samples of one sweep
+    template<uint16_t Capacity>
+    struct Scan
+    {
+            uint32_t  sequence {0};     // Number of the sweep since the assembler was created
+            uint16_t  size     {0};     // Number of valid points
+            ScanPoint points[Capacity];
+    };
+
+    // Merges timestamped measurements with an angle source into per sweep scans.
+    //
+    // The angle comes either from encoder samples fed through pushAngle() or from a commanded profile. It is
+    // linearly interpolated between the two encoder samples around every measurement. Measurements newer than the
+    // newest encoder sample wait, up to PendingSamples of them, for the next encoder sample. When the wait queue is
+    // full or flushPending() is called, the oldest waiting measurements take the newest encoder angle. The angle is
+    // never extrapolated. A sweep ends when the angle changes direction, jumps by more than the wrap threshold, the
+    // scan is full or endSweep() is called.
+    //
+    // The two scan buffers are preallocated. The producer (pushAngle, pushMeasure, flushPending, endSweep) fills
+    // one while the consumer (acquireScan, releaseScan) processes the other. Producer and consumer may run in
+    // different threads.
+    template<uint16_t Capacity, uint16_t AngleSamples = 16, uint16_t PendingSamples = 16>
+    class ScanAssembler
+    {
+            static_assert(Capacity > 0, "Scan capacity must not be zero");
+            static_assert(AngleSamples >= 2, "At least two angle samples are needed for interpolation");
+            static_assert(PendingSamples > 0, "At least one measurement must be able to wait for the encoder");
+
+        public:
+            using scan_t = Scan<Capacity>;
+
+            ScanAssembler() = default;
+
+            explicit ScanAssembler(angle_profile_t profile):
+                m_profile{profile}
+            {
+            }
+
+            ScanAssembler(const ScanAssembler &) = delete;
+            ScanAssembler &operator=(const ScanAssembler &) = delete;
+
+            // Add an encoder sample. Timestamps must be monotonic and angles must not wrap around.
+            void pushAngle(const uint32_t timestamp, const float angle)
+            {
+                m_angles[m_angle_head] = {timestamp, angle};
+                m_angle_head = (m_angle_head + 1) % AngleSamples;
+                if(m_angle_count < AngleSamples)
+                    ++m_angle_count;
+
+                while(m_pending_count > 0 && !isAhead(m_pending[m_pending_head].timestamp))
+                    placePending();
+            }
+
+            // Add a measurement to the current sweep, or to the wait queue if it is newer than the newest encoder
+            // sample. Returns false if there is no angle source yet.
+            bool pushMeasure(const TimedMeasurement &measure)
+            {
+                if(m_profile != nullptr)
+                {
+                    place(measure, m_profile(measure.timestamp));
+                    return true;
+                }
+
+                if(m_angle_count == 0)
+                    return false;
+
+                if(m_pending_count == 0 && !isAhead(measure.timestamp))
+                {
+                    place(measure, angleAt(measure.timestamp));
+                    return true;
+                }
+
+                // Bound the latency: the oldest waiting measurement gives up and takes the newest encoder angle
+                if(m_pending_count == PendingSamples)
+                    placePending();
+
+                m_pending[(m_pending_head + m_pending_count) % PendingSamples] = measure;
+                ++m_pending_count;
+                return true;
+            }
+
+            // Place the measurements still waiting for an encoder sample at the newest encoder angle, e.g. when
+            // the encoder stops
+            void flushPending()
+            {
+                while(m_pending_count > 0)
+                    placePending();
+            }
+
+            // Close the current sweep and hand it over to the consumer
+            void endSweep()
+            {
+                if(m_fill_size == 0)
+                    return;
+
+                scan_t &scan = m_scans[m_fill];
+                scan.size = m_fill_size;
+                scan.sequence = m_sequence++;
+
+                m_fill_size = 0;
+                m_direction = 0;
+
+                const uint8_t other = m_fill ^ 1;
+                uint8_t state = m_state.load(std::memory_order_relaxed);
+
+                while(true)
+                {
+                    // The consumer still works on the other buffer, so drop this sweep and refill the same buffer
+                    if(held(state) == other)
+                    {
+                        m_dropped.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+
+                    // The previously published sweep was never picked up and gets overwritten
+                    const bool overwrite = published(state) == other;
+
+                    if(m_state.compare_exchange_weak(state, makeState(m_fill, held(state)),
+                                                     std::memory_order_acq_rel, std::memory_order_relaxed))
+                    {
+                        if(overwrite)
+                            m_dropped.fetch_add(1, std::memory_order_relaxed);
+
+                        m_fill = other;
+                        return;
+                    }
+                }
+            }
+
+            // Take the most recently completed sweep. Returns nullptr if there is none. The scan stays valid until
+            // releaseScan() is called.
+            const scan_t *acquireScan()
+            {
+                uint8_t state = m_state.load(std::memory_order_relaxed);
+
+                while(true)
+                {
+                    if(published(state) == NONE || held(state) != NONE)
+                        return nullptr;
+
+                    const uint8_t index = published(state);
+                    if(m_state.compare_exchange_weak(state, makeState(NONE, index),
+                                                     std::memory_order_acquire, std::memory_order_relaxed))
+                        return &m_scans[index];
+                }
+            }
+
+            void releaseScan()
+            {
+                uint8_t state = m_state.load(std::memory_order_relaxed);
+                while(!m_state.compare_exchange_weak(state, makeState(published(state), NONE),
+                                                     std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            float getWrapThreshold() const
+            {
+                return m_wrap_threshold;
+            }
+
+            // Angle jump between two consecutive samples that is treated as the start of a new sweep
+            void setWrapThreshold(const float value)
+            {
+                m_wrap_threshold = value < 0 ? -value : value;
+            }
+
+            // Number of sweeps lost because the consumer did not keep up
+            uint32_t getDroppedScans() const
+            {
+                return m_dropped.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct AngleSample
+            {
+                    uint32_t timestamp {0};
+                    float    angle     {0};
+            };
+
+            static constexpr uint8_t NONE = 0x03;
+
+            static constexpr uint8_t makeState(const uint8_t published, const uint8_t held)
+            {
+                return uint8_t(published | (held << 2));
+            }
+
+            static constexpr uint8_t published(const uint8_t state)
+            {
+                return state & 0x03;
+            }
+
+            static constexpr uint8_t held(const uint8_t state)
+            {
+                return (state >> 2) & 0x03;
+            }
+
+            // Newer than the newest encoder sample
+            bool isAhead(const uint32_t timestamp) const
+            {
+                return int32_t(timestamp - angleSample(0).timestamp) > 0;
+            }
+
+            void placePending()
+            {
+                const TimedMeasurement &measure = m_pending[m_pending_head];
+                place(measure, angleAt(measure.timestamp));
+
+                m_pending_head = (m_pending_head + 1) % PendingSamples;
+                --m_pending_count;
+            }
+
+            void place(const TimedMeasurement &measure, const float angle)
+            {
+                if(m_fill_size > 0)
+                {
+                    const float delta = angle - m_last_angle;
+                    const bool  wrap  = delta > m_wrap_threshold || -delta > m_wrap_threshold;
+                    const int16_t direction = delta > 0 ? 1 : (delta < 0 ? -1 : 0);
+
+                    if(wrap || (direction != 0 && m_direction != 0 && direction != m_direction))
+                        endSweep();
+                    else if(m_direction == 0)
+                        m_direction = direction;
+                }
+
+                scan_t &scan = m_scans[m_fill];
+                scan.points[m_fill_size] = {measure.timestamp, angle, measure.measure};
+                m_last_angle = angle;
+
+                if(++m_fill_size == Capacity)
+                    endSweep();
+            }
+
+            const AngleSample &angleSample(const uint16_t age) const
+            {
+                return m_angles[(m_angle_head + AngleSamples - 1 - age) % AngleSamples];
+            }
+
+            // Encoder angle at the timestamp, held at the oldest and newest sample outside of the buffered range
+            float angleAt(const uint32_t timestamp) const
+            {
+                if(m_angle_count == 1)
+                    return angleSample(0).angle;
+
+                // Find the newest pair of samples that brackets the timestamp. Measurements are usually newer than
+                // most of the encoder samples, so search from the newest one.
+                uint16_t age = 0;
+                while(age + 2 < m_angle_count && int32_t(timestamp - angleSample(age + 1).timestamp) < 0)
+                    ++age;
+
+                const AngleSample &newer = angleSample(age);
+                const AngleSample &older = angleSample(age + 1);
+                const int32_t span = int32_t(newer.timestamp - older.timestamp);
+                const int32_t offset = int32_t(timestamp - older.timestamp);
+
+                if(span <= 0 || offset >= span)
+                    return newer.angle;
+
+                if(offset <= 0)
+                    return older.angle;
+
+                return older.angle + (newer.angle - older.angle) * (float(offset) / float(span));
+            }
+
+            scan_t               m_scans[2];
+            std::atomic<uint8_t> m_state{makeState(NONE, NONE)};
+
+            uint8_t  m_fill{0};
+            uint16_t m_fill_size{0};
+            uint32_t m_sequence{0};
+
+            std::atomic<uint32_t> m_dropped{0};
+
+            float    m_last_angle{0};
+            int16_t  m_direction{0};
+            float    m_wrap_threshold{90};
+
+            angle_profile_t m_profile{nullptr};
+            AngleSample     m_angles[AngleSamples];
+            uint16_t        m_angle_head{0};
+            uint16_t        m_angle_count{0};
+
+            TimedMeasurement m_pending[PendingSamples];
+            uint16_t         m_pending_head{0};
+            uint16_t         m_pending_count{0};
+    };
+}
+
+#endif // TFMINI_SCAN_H
@@ -0,0 +1,249 @@
+/*
+ *  _____ _____          _       _
+ * |_   _|  ___| __ ___ (_)_ __ (_)
+ *   | | | |_ | '_ ` _ \| | '_ \| |
+ *   | | |  _|| | | | | | | | | | |
+ *   |_| |_|  |_| |_| |_|_|_| |_|_|
+
+ * C++17 header only, driver library for reading TFmini ToF LIDAR sensors
+ * written in modern C++
+ *
+ * Version: 1.0.2
+ * URL: https://github.com/ekondayan/libtfmini.git
+ *
+ * Copyright (c) 2019 Emil Kondayan
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TFMINI_TRACE_H
+#define TFMINI_TRACE_H
+
+#include "tfmini_defs.h"
+
+// Tracing of the command and acquisition path. Define TFMINI_TRACE before including the library to enable it,
+// otherwise the hooks expand to nothing.
+//
+// Every thread that goes through a hook claims one fixed size ring of records. A scope is stored as one record,
+// with its begin time and duration, when it ends, so a wrapped ring never holds half of a scope. Provide a
+// microsecond clock with trace::setClock() and dump the rings with trace::exportChrome() as Chrome/Perfetto trace
+// JSON. Each device is
+// shown as a separate process and each thread as a separate track. Export while the traced threads are idle,
+// otherwise records that are being written may be torn.
+
+#ifdef TFMINI_TRACE
+
+#include <atomic>
+
+#ifndef TFMINI_TRACE_RECORDS
+#define TFMINI_TRACE_RECORDS 1024   // Records per thread, must be a power of two
+#endif
+
+#ifndef TFMINI_TRACE_THREADS
+#define TFMINI_TRACE_THREADS 8      // Maximum number of traced threads
+#endif
+
+namespace tfmini
+{
+    namespace trace
+    {
+        static_assert((TFMINI_TRACE_RECORDS & (TFMINI_TRACE_RECORDS - 1)) == 0, "TFMINI_TRACE_RECORDS must be a power of two");
+
+        // Receives chunks of the exported JSON
+        using writer_t = void (*)(const char *text, uint16_t len, void *context);
+
+        enum Event : uint8_t
+        {
+            EVENT_SEND_COMMAND = 0,
+            EVENT_EXEC_RETRY,
+            EVENT_PHY_SEND,
+            EVENT_PHY_RECEIVE,
+            EVENT_DECODE
+        };
+
+        // The value is the status for sendCommand, the retry number for execCmd, the byte count for send and
+        // receive and the reading for decode
+        struct Record
+        {
+                uint32_t timestamp {0};     // Begin of the scope
+                uint32_t duration  {0};
+                uint16_t value     {0};
+                uint8_t  event     {0};
+                uint8_t  device    {0};
+        };
+
+        struct Ring
+        {
+                Record                record[TFMINI_TRACE_RECORDS];
+                std::atomic<uint32_t> head{0};
+        };
+
+        inline Ring                        rings[TFMINI_TRACE_THREADS];
+        inline std::atomic<uint16_t>       rings_claimed{0};
+        inline std::atomic<clock_source_t> clock_source{nullptr};
+
+        inline void setClock(clock_source_t source)
+        {
+            clock_source.store(source, std::memory_order_relaxed);
+        }
+
+        // Ring of the calling thread, nullptr if all rings are taken
+        inline Ring *threadRing()
+        {
+            thread_local Ring *ring = [](){
+                const uint16_t index = rings_claimed.fetch_add(1, std::memory_order_relaxed);
+                return index < TFMINI_TRACE_THREADS ? &rings[index] : nullptr;
+            }();
+
+            return ring;
+        }
+
+        inline uint32_t now()
+        {
+            const clock_source_t source = clock_source.load(std::memory_order_relaxed);
+            return source != nullptr ? source() : 0;
+        }
+
+        inline void record(const Event event, const uint32_t begin, const uint8_t device, const uint16_t value)
+        {
+            const clock_source_t source = clock_source.load(std::memory_order_relaxed);
+            Ring *ring = threadRing();
+
+            if(source == nullptr || ring == nullptr)
+                return;
+
+            const uint32_t head = ring->head.load(std::memory_order_relaxed);
+            ring->record[head & (TFMINI_TRACE_RECORDS - 1)] = {begin, source() - begin, value, event, device};
+            ring->head.store(head + 1, std::memory_order_release);
+        }
+
+        // Takes the begin time on construction and records the whole scope, with the value set in between, on
+        // destruction
+        class Scope
+        {
+            public:
+                Scope(const Event event, const uint8_t device, const uint16_t value):
+                    m_begin{now()},
+                    m_event{event},
+                    m_device{device},
+                    m_value{value}
+                {
+                }
+
+                ~Scope()
+                {
+                    record(m_event, m_begin, m_device, m_value);
+                }
+
+                Scope(const Scope &) = delete;
+                Scope &operator=(const Scope &) = delete;
+
+                void setValue(const uint16_t value)
+                {
+                    m_value = value;
+                }
+
+            private:
+                uint32_t m_begin;
+                Event    m_event;
+                uint8_t  m_device;
+                uint16_t m_value;
+        };
+
+        namespace detail
+        {
+            inline void write(writer_t writer, void *context, const char *text)
+            {
+                uint16_t len = 0;
+                while(text[len] != '\0')
+                    ++len;
+
+                writer(text, len, context);
+            }
+
+            inline void write(writer_t writer, void *context, uint32_t value)
+            {
+                char text[11];
+                int16_t pos = sizeof(text) - 1;
+                text[pos] = '\0';
+
+                do
+                {
+                    text[--pos] = char('0' + value % 10);
+                    value /= 10;
+                }
+                while(value != 0);
+
+                write(writer, context, text + pos);
+            }
+
+            inline const char *eventName(const uint8_t event)
+            {
+                switch(event)
+                {
+                    case EVENT_SEND_COMMAND: return "sendCommand";
+                    case EVENT_EXEC_RETRY:   return "execCmd";
+                    case EVENT_PHY_SEND:     return "send";
+                    case EVENT_PHY_RECEIVE:  return "receive";
+                    case EVENT_DECODE:       return "decode";
+                }
+
+                return "unknown";
+            }
+        }
+
+        // Write the records of all threads as Chrome trace JSON through the writer
+        inline void exportChrome(writer_t writer, void *context = nullptr)
+        {
+            if(writer == nullptr)
+                return;
+
+            bool first = true;
+            detail::write(writer, context, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+            const uint16_t claimed = rings_claimed.load(std::memory_order_relaxed);
+            for(uint16_t thread = 0; thread < claimed && thread < TFMINI_TRACE_THREADS; ++thread)
+            {
+                const Ring &ring = rings[thread];
+                const uint32_t head  = ring.head.load(std::memory_order_acquire);
+                const uint32_t count = head < TFMINI_TRACE_RECORDS ? head : TFMINI_TRACE_RECORDS;
+
+                for(uint32_t i = head - count; i != head; ++i)
+                {
+                    const Record &rec = ring.record[i & (TFMINI_TRACE_RECORDS - 1)];
+
+                    detail::write(writer, context, first ? "\n{\"name\":\"" : ",\n{\"name\":\"");
+                    detail::write(writer, context, detail::eventName(rec.event));
+                    detail::write(writer, context, "\",\"ph\":\"X\",\"ts\":");
+                    detail::write(writer, context, rec.timestamp);
+                    detail::write(writer, context, ",\"dur\":");
+                    detail::write(writer, context, rec.duration);
+                    detail::write(writer, context, ",\"pid\":");
+                    detail::write(writer, context, rec.device);
+                    detail::write(writer, context, ",\"tid\":");
+                    detail::write(writer, context, thread);
+                    detail::write(writer, context, ",\"args\":{\"value\":");
+                    detail::write(writer, context, rec.value);
+                    detail::write(writer, context, "}}");
+                    first = false;
+                }
+            }
+
+            detail::write(writer, context, "\n]}\n");
+        }
+    }
+}
+
+#define TFMINI_TRACE_SCOPE(name, event, device, value) tfmini::trace::Scope name{tfmini::trace::event, device, uint16_t(value)}
+#define TFMINI_TRACE_VALUE(name, value)                name.setValue(uint16_t(value))
+
+#else
+
+#define TFMINI_TRACE_SCOPE(name, event, device, value)
+#define TFMINI_TRACE_VALUE(name, value)
+
+#endif // TFMINI_TRACE
+
+#endif // TFMINI_TRACE_H